@@ -0,0 +1,967 @@
+/**
+   @file
+*/
+
+#include "ModelBenchmark.h"
+#include "EditableModelItem.h"
+#include "EditableModelBase.h"
+#include "JointItem.h"
+#include "LinkItem.h"
+#include "PrimitiveShapeItem.h"
+#include "MeshShapeItem.h"
+#include "SensorItem.h"
+#include "VRMLModelWriter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "DoubleFormatter.h"
+#include "SelectionTracker.h"
+#include "ModelEditDragger.h"
+#include "SharedShapes.h"
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include <cnoid/Link>
+#include <cnoid/Sensor>
+#include <cnoid/Camera>
+#include <cnoid/RangeSensor>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EigenUtil>
+#include <cnoid/ConnectionSet>
+#include <cnoid/BodyLoader>
+#include <QElapsedTimer>
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <typeinfo>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const char* formats[] = { "wrl", "urdf", "sdf" };
+const int NUM_FORMATS = sizeof(formats) / sizeof(formats[0]);
+
+// camera, range, acceleration, force and gyro
+const int NUM_SENSOR_TYPES = 5;
+
+struct SyntheticModel
+{
+    EditableModelItemPtr item;
+    // the items refer to the links and the devices without owning them
+    vector<LinkPtr> links;
+    vector<DevicePtr> devices;
+};
+
+
+/**
+   The peak of the resident set size is reset by writing 5 to clear_refs,
+   which is supported by Linux 4.0 or later.
+*/
+bool resetPeakRSS()
+{
+    ofstream ofs("/proc/self/clear_refs");
+    if(!ofs){
+        return false;
+    }
+    ofs << "5";
+    ofs.close();
+    return !ofs.fail();
+}
+
+
+// a size in kB of /proc/self/status
+long readStatus(const char* key)
+{
+    const size_t length = strlen(key);
+    ifstream ifs("/proc/self/status");
+    string line;
+    while(getline(ifs, line)){
+        if(line.compare(0, length, key) == 0){
+            return atol(line.c_str() + length);
+        }
+    }
+    return -1;
+}
+
+
+long readPeakRSS()
+{
+    return readStatus("VmHWM:");
+}
+
+
+DevicePtr createSensor(int index, Link* link)
+{
+    DevicePtr device;
+    switch(index % NUM_SENSOR_TYPES){
+    case 0: {
+        Camera* camera = new Camera;
+        camera->setResolution(640, 480);
+        camera->setFieldOfView(PI / 3.0);
+        camera->setFrameRate(30.0);
+        device = camera;
+        break;
+    }
+    case 1: {
+        RangeSensor* range = new RangeSensor;
+        range->setYawRange(PI);
+        range->setYawStep(PI / 360.0);
+        range->setMaxDistance(10.0);
+        device = range;
+        break;
+    }
+    case 2:
+        device = new AccelerationSensor;
+        break;
+    case 3:
+        device = new ForceSensor;
+        break;
+    default:
+        device = new RateGyroSensor;
+        break;
+    }
+    ostringstream name;
+    name << "SENSOR" << index;
+    device->setName(name.str());
+    device->setId(index);
+    device->setLink(link);
+    device->T_local().translation() = Vector3(0.0, 0.0, 0.05);
+    return device;
+}
+
+
+/**
+   Builds the items in the same structure as buildItemTree of the plugin.
+   The joints form a binary tree, so that the depth of the items is small,
+   or a chain, so that the depth is the number of the links.
+   The mesh items refer to a file which does not exist, so the models with
+   the meshes cannot be loaded back.
+*/
+void buildSyntheticModel(SyntheticModel& model, int numLinks, int numShapes, int numSensors,
+                         bool hasMeshes = true, bool isChain = false)
+{
+    MeshGenerator meshGenerator;
+    SgShapePtr primitive = new SgShape;
+    primitive->setMesh(meshGenerator.generateBox(Vector3(0.1, 0.1, 0.1)));
+    primitive->setMaterial(new SgMaterial);
+    SgShapePtr mesh = new SgShape;
+    mesh->setMesh(meshGenerator.generateSphere(0.05));
+    mesh->setMaterial(new SgMaterial);
+
+    ostringstream modelName;
+    modelName << "synthetic" << numLinks;
+    model.item = new EditableModelItem;
+    model.item->setName(modelName.str());
+
+    vector<JointItem*> jointItems;
+    for(int i=0; i < numLinks; ++i){
+        LinkPtr link = new Link;
+        ostringstream name;
+        name << "JOINT" << i;
+        link->setName(name.str());
+        if(i == 0){
+            link->setJointType(Link::FIXED_JOINT);
+            link->setJointId(-1);
+        } else {
+            link->setJointType(Link::ROTATIONAL_JOINT);
+            link->setJointId(i - 1);
+            link->setOffsetTranslation(Vector3(0.0, 0.05 * (i % 2 ? 1 : -1), 0.1));
+        }
+        link->setJointAxis(Vector3::Unit(i % 3));
+        link->setJointRange(-PI / 2.0, PI / 2.0);
+        link->setJointVelocityRange(-PI, PI);
+        link->setMass(1.0);
+        link->setCenterOfMass(Vector3(0.0, 0.0, 0.05));
+        link->setInertia(Matrix3::Identity() * 0.001);
+        model.links.push_back(link);
+
+        JointItemPtr jointItem = new JointItem(link);
+        Item* parentItem = model.item.get();
+        if(i > 0){
+            parentItem = jointItems[isChain ? i - 1 : (i - 1) / 2];
+        }
+        parentItem->addChildItem(jointItem);
+        jointItems.push_back(jointItem);
+
+        LinkItemPtr linkItem = new LinkItem(link);
+        jointItem->addChildItem(linkItem);
+        for(int j=0; j < numShapes; ++j){
+            Vector3 p(0.05 * j, 0.0, 0.0);
+            linkItem->addChildItem(new PrimitiveShapeItem(p, Matrix3::Identity(), primitive));
+            if(hasMeshes){
+                linkItem->addChildItem(new MeshShapeItem(p, Matrix3::Identity(), mesh, "synthetic.stl"));
+            }
+        }
+    }
+
+    for(int i=0; i < numSensors && numLinks > 0; ++i){
+        const int linkIndex = (long long)i * numLinks / numSensors;
+        DevicePtr device = createSensor(i, model.links[linkIndex]);
+        model.devices.push_back(device);
+        jointItems[linkIndex]->addChildItem(new SensorItem(device));
+    }
+
+    for(Item* child = model.item->childItem(); child; child = child->nextItem()){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
+        if(item) item->updatePosition();
+    }
+}
+
+
+/**
+   Doubles in [-10, 10) with all the bits of the significand, which are
+   generated by xorshift64 so that the results are reproducible.
+*/
+void generateValues(vector<double>& out_values, int numValues)
+{
+    boost::uint64_t x = 88172645463325252ULL;
+    out_values.resize(numValues);
+    for(int i=0; i < numValues; ++i){
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        out_values[i] = (x >> 11) * (20.0 / 9007199254740992.0) - 10.0;
+    }
+}
+
+
+int countExactValues(const string& text, const vector<double>& values)
+{
+    int numExact = 0;
+    const char* p = text.c_str();
+    for(size_t i=0; i < values.size(); ++i){
+        char* end;
+        const double value = strtod(p, &end);
+        if(end == p){
+            break;
+        }
+        if(value == values[i]){
+            ++numExact;
+        }
+        p = end;
+    }
+    return numExact;
+}
+
+
+// the editable items below the item in preorder
+void collectItems(Item* item, vector<Item*>& out_items)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        if(dynamic_cast<EditableModelBase*>(child)){
+            out_items.push_back(child);
+        }
+        collectItems(child, out_items);
+    }
+}
+
+
+// the nodes shared by several items are counted once
+void collectSceneNodes(SgNode* node, set<SgNode*>& io_nodes)
+{
+    if(!node || !io_nodes.insert(node).second){
+        return;
+    }
+    if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            collectSceneNodes(group->child(i), io_nodes);
+        }
+    }
+}
+
+
+size_t countSceneNodes(const vector<Item*>& items)
+{
+    set<SgNode*> nodes;
+    for(size_t i=0; i < items.size(); ++i){
+        if(SceneProvider* provider = dynamic_cast<SceneProvider*>(items[i])){
+            collectSceneNodes(provider->getScene(), nodes);
+        }
+    }
+    return nodes.size();
+}
+
+
+void countUpdate(int* counter)
+{
+    ++(*counter);
+}
+
+
+void selectItems(const vector<Item*>& items, size_t begin, size_t numSelected)
+{
+    ItemList<Item> selection;
+    for(size_t i=begin; i < begin + numSelected && i < items.size(); ++i){
+        selection.push_back(items[i]);
+    }
+    SelectionTracker::instance()->setSelectedItems(selection);
+}
+
+
+filesystem::path createDirectory(const string& outputDirectory, bool& out_isTemporary)
+{
+    filesystem::path directory(outputDirectory);
+    out_isTemporary = false;
+    if(outputDirectory.empty()){
+        directory = filesystem::temp_directory_path() / filesystem::unique_path("cnoid-benchmark-%%%%%%%%");
+        out_isTemporary = true;
+    }
+    boost::system::error_code ec;
+    filesystem::create_directories(directory, ec);
+    return directory;
+}
+
+
+bool save(const string& format, Item* item, const string& filename, ostream& os)
+{
+    if(format == "wrl"){
+        return VRMLModelWriter::save(item, filename);
+    } else if(format == "urdf"){
+        return URDFWriter::save(item, filename, os);
+    } else if(format == "sdf"){
+        return SDFWriter::save(item, filename, os);
+    }
+    return false;
+}
+
+}
+
+
+ModelBenchmark::ModelBenchmark()
+    : mode("export"),
+      numShapes(1),
+      numSensors(4),
+      numValues(1000000)
+{
+}
+
+
+int ModelBenchmark::run()
+{
+    if(numLinksList.empty()){
+        if(mode == "chain"){
+            numLinksList.push_back(50);
+            numLinksList.push_back(100);
+            numLinksList.push_back(200);
+        } else {
+            numLinksList.push_back(10);
+            numLinksList.push_back(100);
+            numLinksList.push_back(1000);
+            numLinksList.push_back(10000);
+        }
+    }
+
+    if(mode == "export"){
+        return runExport();
+    } else if(mode == "format"){
+        return runFormat();
+    } else if(mode == "selection"){
+        return runSelection();
+    } else if(mode == "dragger"){
+        return runDragger();
+    } else if(mode == "primitive"){
+        return runPrimitive();
+    } else if(mode == "sensor"){
+        return runSensor();
+    } else if(mode == "drag"){
+        return runDrag();
+    } else if(mode == "attach"){
+        return runAttach();
+    } else if(mode == "snapshot"){
+        return runSnapshot();
+    } else if(mode == "chain"){
+        return runChain();
+    }
+    cerr << "Benchmark mode \"" << mode << "\" is not supported." << endl;
+    return 1;
+}
+
+
+int ModelBenchmark::runExport()
+{
+    bool isTemporaryDirectory;
+    filesystem::path directory = createDirectory(outputDirectory, isTemporaryDirectory);
+    boost::system::error_code ec;
+
+    bool isPeakResettable = true;
+    bool failed = false;
+
+    cout << "format\tlinks\tprimitives\tmeshes\tsensors\tseconds\tbytes\tpeak_rss_kb" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numLinks = numLinksList[i];
+        ostringstream sizes;
+        sizes << numLinks << "\t" << numLinks * numShapes << "\t" << numLinks * numShapes << "\t"
+              << numSensors;
+
+        QElapsedTimer timer;
+        SyntheticModel model;
+        isPeakResettable = resetPeakRSS() && isPeakResettable;
+        timer.start();
+        buildSyntheticModel(model, numLinks, numShapes, numSensors);
+        cout << "build\t" << sizes.str() << "\t" << timer.nsecsElapsed() / 1.0e9 << "\t0\t"
+             << readPeakRSS() << endl;
+
+        for(int j=0; j < NUM_FORMATS; ++j){
+            const string format(formats[j]);
+            filesystem::path file = directory / (model.item->name() + "." + format);
+            // the mesh summaries are not a part of the results
+            ostringstream messages;
+
+            isPeakResettable = resetPeakRSS() && isPeakResettable;
+            timer.restart();
+            bool saved = save(format, model.item, file.string(), messages);
+            const double seconds = timer.nsecsElapsed() / 1.0e9;
+            const long peakRSS = readPeakRSS();
+
+            boost::uintmax_t bytes = 0;
+            if(saved){
+                bytes = filesystem::file_size(file, ec);
+            } else {
+                cerr << "Saving \"" << file.string() << "\" failed." << endl;
+                failed = true;
+            }
+            filesystem::remove(file, ec);
+
+            cout << format << "\t" << sizes.str() << "\t" << seconds << "\t" << bytes << "\t"
+                 << peakRSS << endl;
+        }
+    }
+
+    if(!isPeakResettable){
+        cerr << "The peak RSS cannot be reset in this system, so the peak of the process is reported." << endl;
+    }
+    if(isTemporaryDirectory){
+        filesystem::remove_all(directory, ec);
+    }
+    return failed ? 1 : 0;
+}
+
+
+/**
+   The default stream is the one the writers used before DoubleFormatter,
+   whose six digits lose the most of the bits of the values. Seventeen digits
+   are read back exactly as the shortest digits of the formatter.
+*/
+int ModelBenchmark::runFormat()
+{
+    vector<double> values;
+    generateValues(values, numValues);
+
+    cout << "writer\tvalues\tseconds\tbytes\tvalues_per_second\texact" << endl;
+
+    const char* writers[] = { "ostream", "ostream17", "formatter", "formatter6" };
+    const int numWriters = sizeof(writers) / sizeof(writers[0]);
+    for(int i=0; i < numWriters; ++i){
+        const string writer(writers[i]);
+        ostringstream os;
+        if(writer == "ostream17"){
+            os << setprecision(17);
+        } else if(writer == "formatter"){
+            os.imbue(DoubleFormatter::locale());
+        } else if(writer == "formatter6"){
+            os.imbue(DoubleFormatter::locale(6));
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        for(size_t j=0; j < values.size(); ++j){
+            os << values[j] << ' ';
+        }
+        const double seconds = timer.nsecsElapsed() / 1.0e9;
+
+        const string text = os.str();
+        cout << writer << "\t" << values.size() << "\t" << seconds << "\t" << text.size() << "\t"
+             << (seconds > 0.0 ? values.size() / seconds : 0.0) << "\t"
+             << countExactValues(text, values) << endl;
+    }
+    return 0;
+}
+
+
+/**
+   Each change deselects one item and selects another one, so the time
+   should depend on neither the number of the items nor the number of the
+   selected items. The selected items attach their draggers as in the GUI.
+*/
+int ModelBenchmark::runSelection()
+{
+    const int numChanges = 1000;
+    const size_t numSelectedList[] = { 1, 100 };
+
+    cout << "items\tselected\tchanges\tseconds_per_change" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        SyntheticModel model;
+        buildSyntheticModel(model, numLinksList[i], numShapes, numSensors);
+        vector<Item*> items;
+        collectItems(model.item, items);
+
+        for(size_t j=0; j < sizeof(numSelectedList) / sizeof(numSelectedList[0]); ++j){
+            const size_t numSelected = numSelectedList[j];
+            if(numSelected >= items.size()){
+                continue;
+            }
+            // the window moves back and forth, so that every change is a shift by one
+            const size_t period = 2 * (items.size() - numSelected);
+            selectItems(items, 0, numSelected);
+
+            QElapsedTimer timer;
+            timer.start();
+            for(int k=1; k <= numChanges; ++k){
+                const size_t phase = k % period;
+                selectItems(items, (phase * 2 <= period) ? phase : period - phase, numSelected);
+            }
+            const double seconds = timer.nsecsElapsed() / 1.0e9;
+
+            selectItems(items, 0, 0);
+            cout << items.size() << "\t" << numSelected << "\t" << numChanges << "\t"
+                 << seconds / numChanges << endl;
+        }
+    }
+    return 0;
+}
+
+
+/**
+   The draggers are pooled by the process, so the draggers created for a
+   model are reused by the next one and the sizes should be measured by
+   separate runs.
+*/
+int ModelBenchmark::runDragger()
+{
+    ModelEditDraggerPool* pool = ModelEditDraggerPool::instance();
+
+    cout << "state\tlinks\titems\tdraggers\tpooled\tscene_nodes\tseconds\trss_kb" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numLinks = numLinksList[i];
+        QElapsedTimer timer;
+        SyntheticModel model;
+        timer.start();
+        buildSyntheticModel(model, numLinks, numShapes, numSensors);
+        double seconds = timer.nsecsElapsed() / 1.0e9;
+        vector<Item*> items;
+        collectItems(model.item, items);
+
+        for(int state=0; state < 3; ++state){
+            const char* stateName = "built";
+            if(state == 1){
+                stateName = "selected";
+                timer.restart();
+                selectItems(items, 0, items.size());
+                seconds = timer.nsecsElapsed() / 1.0e9;
+            } else if(state == 2){
+                stateName = "deselected";
+                timer.restart();
+                selectItems(items, 0, 0);
+                seconds = timer.nsecsElapsed() / 1.0e9;
+            }
+            cout << stateName << "\t" << numLinks << "\t" << items.size() << "\t"
+                 << pool->numCreated() << "\t" << pool->numPooled() << "\t"
+                 << countSceneNodes(items) << "\t" << seconds << "\t" << readStatus("VmRSS:") << endl;
+        }
+    }
+    return 0;
+}
+
+
+/**
+   A change of the size of a primitive looks up the shared meshes in the same
+   way as the creation, so the creation with distinct sizes gives the cost of
+   the regeneration, and the creation with identical sizes gives the cost of
+   the lookup. A pose update must not create any mesh.
+*/
+int ModelBenchmark::runPrimitive()
+{
+    MeshGenerator meshGenerator;
+
+    cout << "operation\titems\tseconds\tshared_meshes" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numItems = numLinksList[i];
+        for(int distinct=0; distinct < 2; ++distinct){
+            vector<PrimitiveShapeItemPtr> items;
+            items.reserve(numItems);
+            vector<SgShapePtr> shapes(distinct ? numItems : 1);
+            for(size_t j=0; j < shapes.size(); ++j){
+                shapes[j] = new SgShape;
+                shapes[j]->setMesh(meshGenerator.generateBox(Vector3(0.1, 0.1, 0.1 + 0.001 * j)));
+                shapes[j]->setMaterial(new SgMaterial);
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            for(int j=0; j < numItems; ++j){
+                items.push_back(new PrimitiveShapeItem(
+                                    Vector3::Zero(), Matrix3::Identity(), shapes[distinct ? j : 0]));
+            }
+            double seconds = timer.nsecsElapsed() / 1.0e9;
+            cout << (distinct ? "create_distinct" : "create_identical") << "\t" << numItems << "\t"
+                 << seconds << "\t" << SharedShapes::numPrimitiveMeshes() << endl;
+
+            if(!distinct){
+                timer.restart();
+                for(int j=0; j < numItems; ++j){
+                    items[j]->translation = Vector3(0.01 * j, 0.0, 0.0);
+                    items[j]->updatePosition();
+                }
+                seconds = timer.nsecsElapsed() / 1.0e9;
+                cout << "move\t" << numItems << "\t" << seconds << "\t"
+                     << SharedShapes::numPrimitiveMeshes() << endl;
+            }
+        }
+        // the unused meshes are released by an insertion into a cache which has
+        // doubled since its last sweep, so they may be left with few items
+        SharedShapes::primitiveMesh(SgMesh::SPHERE, Vector3::Zero(), 0.05 + 0.001 * i, 0.0);
+        cout << "release\t" << numItems << "\t0\t" << SharedShapes::numPrimitiveMeshes() << endl;
+    }
+    return 0;
+}
+
+
+// the cameras and the range sensors alternate
+int ModelBenchmark::runSensor()
+{
+    LinkPtr link = new Link;
+
+    cout << "operation\titems\tseconds\tshared_meshes" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numItems = numLinksList[i];
+        for(int distinct=0; distinct < 2; ++distinct){
+            vector<DevicePtr> devices(numItems);
+            for(int j=0; j < numItems; ++j){
+                devices[j] = createSensor(j % 2, link);
+                if(!distinct){
+                    continue;
+                }
+                if(Camera* camera = dynamic_cast<Camera*>(devices[j].get())){
+                    camera->setFieldOfView(PI / 3.0 + 0.001 * j);
+                } else if(RangeSensor* range = dynamic_cast<RangeSensor*>(devices[j].get())){
+                    range->setMaxDistance(10.0 + 0.01 * j);
+                }
+            }
+
+            vector<SensorItemPtr> items;
+            items.reserve(numItems);
+            QElapsedTimer timer;
+            timer.start();
+            for(int j=0; j < numItems; ++j){
+                items.push_back(new SensorItem(devices[j]));
+            }
+            double seconds = timer.nsecsElapsed() / 1.0e9;
+            cout << (distinct ? "create_distinct" : "create_identical") << "\t" << numItems << "\t"
+                 << seconds << "\t" << SharedShapes::numSensorMeshes() << endl;
+
+            if(!distinct){
+                timer.restart();
+                for(int j=0; j < numItems; ++j){
+                    items[j]->translation = Vector3(0.01 * j, 0.0, 0.0);
+                    items[j]->updatePosition();
+                }
+                seconds = timer.nsecsElapsed() / 1.0e9;
+                cout << "move\t" << numItems << "\t" << seconds << "\t"
+                     << SharedShapes::numSensorMeshes() << endl;
+            }
+        }
+        // released in the same way as the primitive meshes
+        SharedShapes::cameraFrustum(PI / 4.0, 320, 240, 0.01 * (i + 1), 1.0);
+        SharedShapes::rangeSensorFan(PI / 4.0, 0.01 * (i + 1), 1.0);
+        cout << "release\t" << numItems << "\t0\t" << SharedShapes::numSensorMeshes() << endl;
+    }
+    return 0;
+}
+
+
+/**
+   The events are processed as JointItem::onDraggerDragged does, but the
+   scheduler is flushed after each event instead of once per event loop
+   pass, so every event is measured. The descendants of the dragged joint
+   are moved through their scene transforms, so one item should be updated
+   per event regardless of the size of the model.
+*/
+int ModelBenchmark::runDrag()
+{
+    const int numEvents = 1000;
+    ModelUpdateScheduler* scheduler = ModelUpdateScheduler::instance();
+
+    cout << "method\tlinks\titems\tevents\tseconds_per_event\tupdated_items_per_event" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        SyntheticModel model;
+        buildSyntheticModel(model, numLinksList[i], numShapes, numSensors);
+        vector<Item*> items;
+        collectItems(model.item, items);
+        EditableModelBase* root = dynamic_cast<EditableModelBase*>(items.front());
+
+        int numUpdates = 0;
+        ConnectionSet connections;
+        for(size_t j=0; j < items.size(); ++j){
+            connections.add(items[j]->sigUpdated().connect(boost::bind(countUpdate, &numUpdates)));
+        }
+
+        for(int method=0; method < 2; ++method){
+            numUpdates = 0;
+            QElapsedTimer timer;
+            timer.start();
+            for(int j=0; j < numEvents; ++j){
+                root->translation = Vector3(0.001 * (j % 100), 0.0, 0.0);
+                if(method == 0){
+                    // the drag handler before the pose table rewrote and
+                    // notified every descendant for each event
+                    for(size_t k=0; k < items.size(); ++k){
+                        items[k]->notifyUpdate();
+                    }
+                } else {
+                    scheduler->schedule(root);
+                    scheduler->flush();
+                }
+            }
+            const double seconds = timer.nsecsElapsed() / 1.0e9;
+
+            cout << (method == 0 ? "subtree" : "scheduled") << "\t" << numLinksList[i] << "\t"
+                 << items.size() << "\t" << numEvents << "\t"
+                 << seconds / numEvents << "\t" << (double)numUpdates / numEvents << endl;
+        }
+        connections.disconnect();
+    }
+    return 0;
+}
+
+
+int ModelBenchmark::runAttach()
+{
+    bool isTemporaryDirectory;
+    filesystem::path directory = createDirectory(outputDirectory, isTemporaryDirectory);
+    boost::system::error_code ec;
+    bool failed = false;
+
+    cout << "operation\tlinks\titems\tseconds" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numLinks = numLinksList[i];
+        filesystem::path file;
+        {
+            SyntheticModel model;
+            buildSyntheticModel(model, numLinks, numShapes, numSensors, false);
+            file = directory / (model.item->name() + ".wrl");
+            if(!VRMLModelWriter::save(model.item, file.string())){
+                cerr << "Saving \"" << file.string() << "\" failed." << endl;
+                failed = true;
+                continue;
+            }
+        }
+        // the messages of the loader are not a part of the results
+        ostringstream messages;
+
+        QElapsedTimer timer;
+        timer.start();
+        {
+            BodyLoader loader;
+            loader.setMessageSink(messages);
+            BodyPtr body = loader.load(file.string());
+            if(!body){
+                failed = true;
+            }
+        }
+        const double parseSeconds = timer.nsecsElapsed() / 1.0e9;
+
+        EditableModelItemPtr item = new EditableModelItem;
+        timer.restart();
+        if(!item->loadModelFile(file.string(), messages)){
+            failed = true;
+        }
+        const double loadSeconds = timer.nsecsElapsed() / 1.0e9;
+
+        vector<Item*> items;
+        collectItems(item, items);
+        cout << "parse\t" << numLinks << "\t" << items.size() << "\t" << parseSeconds << endl;
+        cout << "load\t" << numLinks << "\t" << items.size() << "\t" << loadSeconds << endl;
+
+        // the item tree view emits a selection change for each insertion and
+        // each check of an item, which is emulated here with half of the
+        // items selected
+        ItemList<Item> selection;
+        for(size_t j=0; j < items.size(); j += 2){
+            selection.push_back(items[j]);
+        }
+        SelectionTracker* tracker = SelectionTracker::instance();
+        for(int batched=0; batched < 2; ++batched){
+            timer.restart();
+            if(batched){
+                tracker->blockUpdates();
+            }
+            for(size_t j=0; j < 2 * items.size(); ++j){
+                tracker->setSelectedItems(selection);
+            }
+            if(batched){
+                tracker->unblockUpdates();
+            }
+            const double seconds = timer.nsecsElapsed() / 1.0e9;
+            cout << (batched ? "signals_batched" : "signals") << "\t" << numLinks << "\t"
+                 << items.size() << "\t" << seconds << endl;
+            tracker->setSelectedItems(ItemList<Item>());
+        }
+        filesystem::remove(file, ec);
+    }
+
+    if(failed){
+        cerr << "Some of the models could not be saved or loaded." << endl;
+    }
+    if(isTemporaryDirectory){
+        filesystem::remove_all(directory, ec);
+    }
+    return failed ? 1 : 0;
+}
+
+
+/**
+   The states of the items are compared through their snapshot records,
+   which are filled by the same writer so that the strings have the same
+   offsets.
+*/
+int ModelBenchmark::runSnapshot()
+{
+    bool isTemporaryDirectory;
+    filesystem::path directory = createDirectory(outputDirectory, isTemporaryDirectory);
+    boost::system::error_code ec;
+    bool failed = false;
+
+    cout << "links\titems\tsensors\tsave_seconds\tload_seconds\tbytes\tmismatched_items\tmismatched_devices" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numLinks = numLinksList[i];
+        SyntheticModel model;
+        buildSyntheticModel(model, numLinks, numShapes, std::max(numSensors, NUM_SENSOR_TYPES), false);
+        const string file = (directory / (model.item->name() + ".mesnap")).string();
+
+        QElapsedTimer timer;
+        timer.start();
+        ModelSnapshotWriter snapshotWriter;
+        if(!snapshotWriter.write(model.item, file, cerr)){
+            failed = true;
+            continue;
+        }
+        const double saveSeconds = timer.nsecsElapsed() / 1.0e9;
+
+        EditableModelItemPtr item = new EditableModelItem;
+        vector<ItemPtr> checkedItems;
+        timer.restart();
+        ModelSnapshotReader reader;
+        if(!reader.read(file, item, checkedItems, cerr)){
+            failed = true;
+        }
+        const double loadSeconds = timer.nsecsElapsed() / 1.0e9;
+
+        vector<Item*> originalItems;
+        vector<Item*> restoredItems;
+        collectItems(model.item, originalItems);
+        collectItems(item, restoredItems);
+
+        int numSensorItems = 0;
+        int numMismatchedItems = std::abs((int)originalItems.size() - (int)restoredItems.size());
+        int numMismatchedDevices = 0;
+        ModelSnapshotWriter recordWriter;
+        for(size_t j=0; j < originalItems.size() && j < restoredItems.size(); ++j){
+            EditableModelBase* original = dynamic_cast<EditableModelBase*>(originalItems[j]);
+            EditableModelBase* restored = dynamic_cast<EditableModelBase*>(restoredItems[j]);
+            ModelSnapshotRecord records[2];
+            std::memset(records, 0, sizeof(records));
+            original->storeState(records[0], recordWriter);
+            restored->storeState(records[1], recordWriter);
+            if(originalItems[j]->name() != restoredItems[j]->name() ||
+               original->translation != restored->translation ||
+               original->rotation != restored->rotation ||
+               std::memcmp(&records[0], &records[1], sizeof(ModelSnapshotRecord)) != 0){
+                ++numMismatchedItems;
+            }
+            SensorItem* originalSensor = dynamic_cast<SensorItem*>(originalItems[j]);
+            if(originalSensor){
+                ++numSensorItems;
+                SensorItem* restoredSensor = dynamic_cast<SensorItem*>(restoredItems[j]);
+                if(!restoredSensor || typeid(*originalSensor->device()) != typeid(*restoredSensor->device())){
+                    ++numMismatchedDevices;
+                }
+            }
+        }
+        if(numMismatchedItems > 0 || numMismatchedDevices > 0){
+            failed = true;
+        }
+
+        cout << numLinks << "\t" << originalItems.size() << "\t" << numSensorItems << "\t"
+             << saveSeconds << "\t" << loadSeconds << "\t" << filesystem::file_size(file, ec) << "\t"
+             << numMismatchedItems << "\t" << numMismatchedDevices << endl;
+        filesystem::remove(file, ec);
+    }
+
+    if(failed){
+        cerr << "Some of the models were not restored exactly from the snapshots." << endl;
+    }
+    if(isTemporaryDirectory){
+        filesystem::remove_all(directory, ec);
+    }
+    return failed ? 1 : 0;
+}
+
+
+/**
+   The URDF writer streams the elements of the items during one traversal,
+   so the time is expected to grow linearly with the length of the chain
+   and the peak memory not to grow with the depth.
+*/
+int ModelBenchmark::runChain()
+{
+    bool isTemporaryDirectory;
+    filesystem::path directory = createDirectory(outputDirectory, isTemporaryDirectory);
+    boost::system::error_code ec;
+
+    bool isPeakResettable = true;
+    bool failed = false;
+
+    cout << "links\tseconds\tseconds_per_link\tbytes\tpeak_rss_kb" << endl;
+
+    for(size_t i=0; i < numLinksList.size(); ++i){
+        const int numLinks = numLinksList[i];
+        SyntheticModel model;
+        buildSyntheticModel(model, numLinks, numShapes, numSensors, false, true);
+        filesystem::path file = directory / (model.item->name() + ".urdf");
+        ostringstream messages;
+
+        isPeakResettable = resetPeakRSS() && isPeakResettable;
+        QElapsedTimer timer;
+        timer.start();
+        bool saved = URDFWriter::save(model.item, file.string(), messages);
+        const double seconds = timer.nsecsElapsed() / 1.0e9;
+        const long peakRSS = readPeakRSS();
+
+        boost::uintmax_t bytes = 0;
+        if(saved){
+            bytes = filesystem::file_size(file, ec);
+        } else {
+            cerr << "Saving \"" << file.string() << "\" failed." << endl;
+            failed = true;
+        }
+        filesystem::remove(file, ec);
+
+        cout << numLinks << "\t" << seconds << "\t" << seconds / numLinks << "\t" << bytes << "\t"
+             << peakRSS << endl;
+    }
+
+    if(!isPeakResettable){
+        cerr << "The peak RSS cannot be reset in this system, so the peak of the process is reported." << endl;
+    }
+    if(isTemporaryDirectory){
+        filesystem::remove_all(directory, ec);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_MODEL_CONVERTER_MODEL_BENCHMARK_H
+#define CNOID_MODEL_CONVERTER_MODEL_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+namespace cnoid {
+
+/**
+   Measures the plugin with synthetic models and writes the results as tab
+   separated rows following a header row. The measurement is selected by
+   the mode:
+   - export: the writers with models of the given numbers of links. Each
+     link has numShapes primitives and numShapes meshes, and numSensors
+     sensors are distributed over the links. The time, the file size and
+     the peak resident set size are written for each format and size.
+   - format: the throughput of DoubleFormatter against ostringstream for
+     numValues doubles, and the number of the values read back exactly.
+   - selection: the time of a selection change dispatched by the
+     SelectionTracker in the models of the given numbers of links, while a
+     window of selected items slides by one item per change.
+   - dragger: the draggers, the scene nodes and the resident set size of the
+     models of the given numbers of links after they are built, after all
+     the items are selected, which corresponds to creating the draggers
+     with the items, and after they are deselected.
+   - primitive: the creation of as many primitive items as the numbers of
+     links with identical and with distinct sizes, a pose update of all the
+     items, and the shared meshes left after the items are released.
+   - sensor: the same as primitive for cameras and range sensors, whose
+     frustums and scanning fans are shared.
+   - drag: the time of a drag event on the root joint of the models of the
+     given numbers of links, and the number of the items updated per event.
+     The subtree rows notify every item for each event as the drag handler
+     did before the poses were derived from the parents, and the scheduled
+     rows schedule and flush the root with the ModelUpdateScheduler.
+   - attach: the time of loading the models of the given numbers of links,
+     written as VRML files without the meshes, and of parsing the files
+     alone. The difference is the time of building and attaching the items.
+     The signals rows give the time of the selection dispatches which the
+     item tree view causes by inserting and checking the loaded items, one
+     dispatch per signal and, in the signals_batched rows, within a block
+     of the SelectionTracker as the attach does.
+   - snapshot: the time of saving and loading a snapshot of the models of
+     the given numbers of links, which have a sensor of each type at least,
+     and the numbers of the items and the sensor devices which are not
+     restored exactly. The mode fails when any of them differs.
+   - chain: the time, the file size and the peak resident set size of the
+     URDF export of models whose joints form a single chain, 50, 100 and
+     200 links long by default.
+
+   The numbers of links default to 10, 100, 1000 and 10000 in the other
+   modes.
+*/
+class ModelBenchmark
+{
+public:
+    std::string mode;
+    std::vector<int> numLinksList;
+    int numShapes;
+    int numSensors;
+    int numValues;
+    std::string outputDirectory;
+
+    ModelBenchmark();
+
+    int run();
+
+private:
+    int runExport();
+    int runFormat();
+    int runSelection();
+    int runDragger();
+    int runPrimitive();
+    int runSensor();
+    int runDrag();
+    int runAttach();
+    int runSnapshot();
+    int runChain();
+};
+
+}
+
+#endif
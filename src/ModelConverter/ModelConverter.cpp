@@ -0,0 +1,421 @@
+/**
+   @file
+   Command line tool which converts model files with the loaders and the
+   writers of the model edit plugin. The files are written in parallel.
+   With --benchmark, the writers are measured with synthetic models.
+*/
+
+#include "EditableModelItem.h"
+#include "VRMLModelWriter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "GLBWriter.h"
+#include "ModelFileStream.h"
+#include "ModelBenchmark.h"
+#include <cnoid/FileUtil>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const char* formats[] = { "wrl", "urdf", "sdf", "glb", "wrl.gz", "urdf.gz" };
+const int NUM_FORMATS = sizeof(formats) / sizeof(formats[0]);
+
+struct ConversionJob
+{
+    string inputFile;
+    string outputFile;
+    // only set and reset by the loading thread
+    EditableModelItemPtr item;
+    string messages;
+    bool succeeded;
+    double loadTime;
+    double saveTime;
+};
+
+/**
+   The models are loaded by the calling thread one by one, because the items
+   share scene nodes whose reference counts are not thread-safe, and the
+   loaded models are written by the other threads. A written model is
+   released by the loading thread, too.
+*/
+class ModelConverter
+{
+public:
+    string format;
+    string outputDirectory;
+    int numThreads;
+    vector<ConversionJob> jobs;
+
+    ModelConverter() : numThreads(0), numMeshThreads(0), isLoadingFinished(false) { }
+
+    bool addJob(const string& inputFile);
+    int run();
+
+private:
+    // the hardware threads are shared by the writers for exporting the meshes
+    int numMeshThreads;
+    // absolute paths of the output files to detect the inputs written to the same file
+    set<string> outputFiles;
+    // indices of the jobs whose models wait for a writer
+    deque<size_t> loadedJobs;
+    // indices of the jobs whose models wait for the release
+    vector<size_t> writtenJobs;
+    bool isLoadingFinished;
+    boost::mutex queueMutex;
+    boost::condition_variable loadedCondition;
+    boost::condition_variable writtenCondition;
+    boost::mutex outputMutex;
+
+    void loadFiles();
+    void writeFiles();
+    void load(ConversionJob& job);
+    void write(ConversionJob& job);
+    bool save(EditableModelItem* item, const string& filename, ostream& os);
+    void putResult(const ConversionJob& job);
+};
+
+}
+
+
+bool ModelConverter::addJob(const string& inputFile)
+{
+    filesystem::path path(inputFile);
+    filesystem::path outputPath =
+        outputDirectory.empty() ? path.parent_path() : filesystem::path(outputDirectory);
+    outputPath /= filesystem::path(removeGzipExtension(inputFile)).stem().string() + "." + format;
+
+    ConversionJob job;
+    job.inputFile = inputFile;
+    job.outputFile = getNativePathString(outputPath);
+    boost::system::error_code ec;
+    if(filesystem::equivalent(path, outputPath, ec)){
+        cerr << "\"" << inputFile << "\" would be overwritten by its output." << endl;
+        return false;
+    }
+    filesystem::path directory = filesystem::canonical(outputPath.parent_path(), ec);
+    if(ec){
+        directory = filesystem::absolute(outputPath.parent_path());
+    }
+    if(!outputFiles.insert(getNativePathString(directory / outputPath.filename())).second){
+        cerr << "\"" << inputFile << "\" would be written to \"" << job.outputFile
+             << "\", which is the output of another input file." << endl;
+        return false;
+    }
+    job.succeeded = false;
+    job.loadTime = 0.0;
+    job.saveTime = 0.0;
+    jobs.push_back(job);
+    return true;
+}
+
+
+int ModelConverter::run()
+{
+    if(jobs.empty()){
+        return 0;
+    }
+    if(!outputDirectory.empty()){
+        boost::system::error_code ec;
+        filesystem::create_directories(filesystem::path(outputDirectory), ec);
+    }
+    if(numThreads <= 0){
+        numThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    }
+    numThreads = std::min(numThreads, (int)jobs.size());
+    numMeshThreads = std::max(1, (int)boost::thread::hardware_concurrency() / numThreads);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    boost::thread_group threads;
+    for(int i=0; i < numThreads; ++i){
+        threads.create_thread(boost::bind(&ModelConverter::writeFiles, this));
+    }
+    loadFiles();
+    threads.join_all();
+    for(size_t i=0; i < jobs.size(); ++i){
+        jobs[i].item = 0;
+    }
+
+    int numFailures = 0;
+    for(size_t i=0; i < jobs.size(); ++i){
+        if(!jobs[i].succeeded){
+            ++numFailures;
+        }
+    }
+    cout << jobs.size() - numFailures << " of " << jobs.size() << " files converted in "
+         << timer.elapsed() / 1000.0 << " s with " << numThreads << " writing threads." << endl;
+
+    return numFailures == 0 ? 0 : 1;
+}
+
+
+void ModelConverter::loadFiles()
+{
+    for(size_t i=0; i < jobs.size(); ++i){
+        ConversionJob& job = jobs[i];
+        load(job);
+        const bool loaded = (job.item.get() != 0);
+
+        vector<size_t> written;
+        {
+            boost::mutex::scoped_lock lock(queueMutex);
+            if(loaded){
+                // the models waiting for the writers are limited to save the memory
+                while(loadedJobs.size() >= (size_t)numThreads){
+                    writtenCondition.wait(lock);
+                }
+                loadedJobs.push_back(i);
+                loadedCondition.notify_one();
+            }
+            written.swap(writtenJobs);
+        }
+        for(size_t j=0; j < written.size(); ++j){
+            jobs[written[j]].item = 0;
+        }
+        if(!loaded){
+            putResult(job);
+        }
+    }
+
+    boost::mutex::scoped_lock lock(queueMutex);
+    isLoadingFinished = true;
+    loadedCondition.notify_all();
+}
+
+
+void ModelConverter::writeFiles()
+{
+    while(true){
+        size_t index;
+        {
+            boost::mutex::scoped_lock lock(queueMutex);
+            while(loadedJobs.empty() && !isLoadingFinished){
+                loadedCondition.wait(lock);
+            }
+            if(loadedJobs.empty()){
+                break;
+            }
+            index = loadedJobs.front();
+            loadedJobs.pop_front();
+            writtenCondition.notify_one();
+        }
+        write(jobs[index]);
+        putResult(jobs[index]);
+
+        boost::mutex::scoped_lock lock(queueMutex);
+        writtenJobs.push_back(index);
+    }
+}
+
+
+void ModelConverter::load(ConversionJob& job)
+{
+    ostringstream messages;
+    QElapsedTimer timer;
+    timer.start();
+
+    EditableModelItemPtr item = new EditableModelItem;
+    item->setName(filesystem::path(removeGzipExtension(job.inputFile)).stem().string());
+    if(item->loadModelFile(job.inputFile, messages)){
+        job.item = item;
+    } else {
+        messages << "\"" << job.inputFile << "\" cannot be loaded." << endl;
+    }
+    job.loadTime = timer.nsecsElapsed() / 1.0e9;
+    job.messages = messages.str();
+}
+
+
+void ModelConverter::write(ConversionJob& job)
+{
+    ostringstream messages;
+    QElapsedTimer timer;
+    timer.start();
+    job.succeeded = save(job.item, job.outputFile, messages);
+    job.saveTime = timer.nsecsElapsed() / 1.0e9;
+    job.messages += messages.str();
+}
+
+
+void ModelConverter::putResult(const ConversionJob& job)
+{
+    boost::mutex::scoped_lock lock(outputMutex);
+    cout << job.messages;
+    cout << (job.succeeded ? "converted " : "failed ") << job.inputFile;
+    if(job.succeeded){
+        cout << " -> " << job.outputFile;
+    }
+    cout << " (load " << job.loadTime << " s, save " << job.saveTime << " s)" << endl;
+}
+
+
+bool ModelConverter::save(EditableModelItem* item, const string& filename, ostream& os)
+{
+    // the writers compress the files whose names end with ".gz"
+    const string format = removeGzipExtension(this->format);
+    if(format == "wrl"){
+        return VRMLModelWriter::save(item, filename);
+    } else if(format == "urdf"){
+        return URDFWriter::save(item, filename, os, numMeshThreads);
+    } else if(format == "sdf"){
+        return SDFWriter::save(item, filename, os, numMeshThreads);
+    } else if(format == "glb"){
+        return GLBWriter::save(item, filename);
+    }
+    return false;
+}
+
+
+namespace {
+
+void putUsage(const char* command)
+{
+    cerr << "Usage: " << command << " [options] files...\n"
+         << "       " << command << " --benchmark [benchmark options]\n"
+         << "Options:\n"
+         << "  -f, --format FORMAT   output format: wrl, urdf, sdf, glb, wrl.gz or urdf.gz (default: urdf)\n"
+         << "  -o, --output DIR      output directory (default: the directory of each input file)\n"
+         << "  -j, --jobs N          number of files written at once (default: number of cores)\n"
+         << "  -h, --help            show this message\n"
+         << "Benchmark options:\n"
+         << "  --mode MODE           export, format, selection, dragger, primitive, sensor, drag,\n"
+         << "                        attach, snapshot or chain (default: export)\n"
+         << "  --links N,N,...       numbers of the links of the synthetic models\n"
+         << "                        (default: 50,100,200 for chain, otherwise 10,100,1000,10000)\n"
+         << "  --shapes M            primitives and meshes of each link (default: 1)\n"
+         << "  --sensors K           sensors of each model (default: 4)\n"
+         << "  --values N            doubles written by the format mode (default: 1000000)\n"
+         << "  -o, --output DIR      directory of the written files (default: a temporary directory)" << endl;
+}
+
+
+bool parseNumbers(const string& value, vector<int>& out_numbers)
+{
+    out_numbers.clear();
+    istringstream iss(value);
+    string token;
+    while(getline(iss, token, ',')){
+        int number = atoi(token.c_str());
+        if(number <= 0){
+            return false;
+        }
+        out_numbers.push_back(number);
+    }
+    return !out_numbers.empty();
+}
+
+
+int runBenchmark(int argc, char* argv[])
+{
+    ModelBenchmark benchmark;
+
+    for(int i=2; i < argc; ++i){
+        string arg(argv[i]);
+        if(i + 1 >= argc){
+            cerr << "Option " << arg << " requires a value." << endl;
+            return 1;
+        }
+        string value(argv[++i]);
+        if(arg == "--mode"){
+            benchmark.mode = value;
+        } else if(arg == "--links"){
+            if(!parseNumbers(value, benchmark.numLinksList)){
+                cerr << "\"" << value << "\" is not a list of positive numbers." << endl;
+                return 1;
+            }
+        } else if(arg == "--shapes"){
+            benchmark.numShapes = std::max(0, atoi(value.c_str()));
+        } else if(arg == "--sensors"){
+            benchmark.numSensors = std::max(0, atoi(value.c_str()));
+        } else if(arg == "--values"){
+            benchmark.numValues = std::max(0, atoi(value.c_str()));
+        } else if(arg == "-o" || arg == "--output"){
+            benchmark.outputDirectory = value;
+        } else {
+            cerr << "Unknown option " << arg << "." << endl;
+            putUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    return benchmark.run();
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    // the items post their deferred updates to the event loop of the application,
+    // which is never run because the models are not displayed
+    QCoreApplication app(argc, argv);
+
+    if(argc > 1 && string(argv[1]) == "--benchmark"){
+        return runBenchmark(argc, argv);
+    }
+
+    ModelConverter converter;
+    converter.format = "urdf";
+    vector<string> inputFiles;
+
+    for(int i=1; i < argc; ++i){
+        string arg(argv[i]);
+        if(arg == "-h" || arg == "--help"){
+            putUsage(argv[0]);
+            return 0;
+        } else if(arg == "-f" || arg == "--format" ||
+                  arg == "-o" || arg == "--output" ||
+                  arg == "-j" || arg == "--jobs"){
+            if(i + 1 >= argc){
+                cerr << "Option " << arg << " requires a value." << endl;
+                return 1;
+            }
+            string value(argv[++i]);
+            if(arg == "-f" || arg == "--format"){
+                converter.format = value;
+            } else if(arg == "-o" || arg == "--output"){
+                converter.outputDirectory = value;
+            } else {
+                converter.numThreads = atoi(value.c_str());
+            }
+        } else if(!arg.empty() && arg[0] == '-'){
+            cerr << "Unknown option " << arg << "." << endl;
+            putUsage(argv[0]);
+            return 1;
+        } else {
+            inputFiles.push_back(arg);
+        }
+    }
+
+    if(std::find(formats, formats + NUM_FORMATS, converter.format) == formats + NUM_FORMATS){
+        cerr << "Format \"" << converter.format << "\" is not supported." << endl;
+        return 1;
+    }
+    if(inputFiles.empty()){
+        putUsage(argv[0]);
+        return 1;
+    }
+    for(size_t i=0; i < inputFiles.size(); ++i){
+        if(!converter.addJob(inputFiles[i])){
+            return 1;
+        }
+    }
+
+    return converter.run();
+}
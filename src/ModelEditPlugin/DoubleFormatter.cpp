@@ -0,0 +1,486 @@
+/**
+   @file
+   The shortest digits are generated by the Grisu2 algorithm of F. Loitsch,
+   "Printing Floating-Point Numbers Quickly and Accurately with Integers" (2010).
+*/
+
+#include "DoubleFormatter.h"
+#include <cnoid/ValueTree>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double MAX_INTEGER = 1.0e15;
+
+// the plain notation is used for the decimal exponents in this range
+const int MIN_PLAIN_EXPONENT = -5;
+const int MAX_PLAIN_EXPONENT = 17;
+
+const boost::uint32_t pow10s[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// normalized 10^k for k = -348, -340, ..., 340
+const boost::uint64_t cachedPowerSignificands[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+const boost::int16_t cachedPowerExponents[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+/**
+   Floating point number f * 2^e with a 64 bit significand.
+*/
+struct DiyFp
+{
+    boost::uint64_t f;
+    int e;
+
+    DiyFp() { }
+    DiyFp(boost::uint64_t f, int e) : f(f), e(e) { }
+
+    DiyFp operator-(const DiyFp& rhs) const { return DiyFp(f - rhs.f, e); }
+
+    // the upper 64 bits of the product, rounded
+    DiyFp operator*(const DiyFp& rhs) const {
+        const boost::uint64_t M32 = 0xffffffffULL;
+        boost::uint64_t a = f >> 32, b = f & M32, c = rhs.f >> 32, d = rhs.f & M32;
+        boost::uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        boost::uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+    }
+
+    DiyFp normalized() const {
+        DiyFp x = *this;
+        while(!(x.f & 0xffe0000000000000ULL)){
+            x.f <<= 11;
+            x.e -= 11;
+        }
+        while(!(x.f & 0x8000000000000000ULL)){
+            x.f <<= 1;
+            x.e -= 1;
+        }
+        return x;
+    }
+};
+
+
+/**
+   Decomposes a positive value of a type with the given significand size and
+   computes the normalized value and its rounding boundaries.
+*/
+void getBoundaries(boost::uint64_t bits, int significandSize, int exponentBits,
+                   DiyFp& out_v, DiyFp& out_minus, DiyFp& out_plus)
+{
+    const boost::uint64_t hiddenBit = 1ULL << significandSize;
+    const int exponentBias = (1 << (exponentBits - 1)) - 1 + significandSize;
+    const int biasedExponent = (int)(bits >> significandSize) & ((1 << exponentBits) - 1);
+    const boost::uint64_t significand = bits & (hiddenBit - 1);
+
+    DiyFp v;
+    if(biasedExponent != 0){
+        v = DiyFp(significand + hiddenBit, biasedExponent - exponentBias);
+    } else {
+        v = DiyFp(significand, 1 - exponentBias);
+    }
+
+    out_plus = DiyFp((v.f << 1) + 1, v.e - 1).normalized();
+    // the lower boundary is closer when the significand is a power of two
+    if(v.f == hiddenBit && biasedExponent > 1){
+        out_minus = DiyFp((v.f << 2) - 1, v.e - 2);
+    } else {
+        out_minus = DiyFp((v.f << 1) - 1, v.e - 1);
+    }
+    out_minus.f <<= out_minus.e - out_plus.e;
+    out_minus.e = out_plus.e;
+    out_v = v.normalized();
+}
+
+
+// c * 2^e is scaled into the range [2^-60, 2^-32] of the digit generation
+DiyFp getCachedPower(int e, int& out_k)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if(dk - k > 0.0){
+        ++k;
+    }
+    int index = (k >> 3) + 1;
+    out_k = -(-348 + (index << 3));
+    return DiyFp(cachedPowerSignificands[index], cachedPowerExponents[index]);
+}
+
+
+int countDecimalDigits(boost::uint32_t n)
+{
+    int digits = 1;
+    while(digits < 10 && n >= pow10s[digits]){
+        ++digits;
+    }
+    return digits;
+}
+
+
+void roundWeed(char* buf, int length, boost::uint64_t delta, boost::uint64_t rest,
+               boost::uint64_t tenKappa, boost::uint64_t wpw)
+{
+    while(rest < wpw && delta - rest >= tenKappa &&
+          (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw)){
+        buf[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+
+void generateDigits(const DiyFp& w, const DiyFp& mp, boost::uint64_t delta,
+                    char* buf, int& out_length, int& io_k)
+{
+    const DiyFp one(1ULL << -mp.e, mp.e);
+    const DiyFp wpw = mp - w;
+    boost::uint32_t p1 = (boost::uint32_t)(mp.f >> -one.e);
+    boost::uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = countDecimalDigits(p1);
+    int length = 0;
+
+    while(kappa > 0){
+        const boost::uint32_t d = p1 / pow10s[kappa - 1];
+        p1 %= pow10s[kappa - 1];
+        if(d || length){
+            buf[length++] = '0' + (char)d;
+        }
+        --kappa;
+        const boost::uint64_t rest = ((boost::uint64_t)p1 << -one.e) + p2;
+        if(rest <= delta){
+            io_k += kappa;
+            roundWeed(buf, length, delta, rest, (boost::uint64_t)pow10s[kappa] << -one.e, wpw.f);
+            out_length = length;
+            return;
+        }
+    }
+
+    while(true){
+        p2 *= 10;
+        delta *= 10;
+        const char d = (char)(p2 >> -one.e);
+        if(d || length){
+            buf[length++] = '0' + d;
+        }
+        p2 &= one.f - 1;
+        --kappa;
+        if(p2 < delta){
+            io_k += kappa;
+            roundWeed(buf, length, delta, p2, one.f, (-kappa < 10) ? wpw.f * pow10s[-kappa] : 0);
+            out_length = length;
+            return;
+        }
+    }
+}
+
+
+/**
+   Writes the shortest digits of a positive value, which is the value of
+   digits * 10^k, and returns the number of the digits.
+*/
+int grisu2(boost::uint64_t bits, int significandSize, int exponentBits, char* buf, int& out_k)
+{
+    DiyFp v, minus, plus;
+    getBoundaries(bits, significandSize, exponentBits, v, minus, plus);
+    const DiyFp c = getCachedPower(plus.e, out_k);
+    const DiyFp w = v * c;
+    DiyFp wp = plus * c;
+    DiyFp wm = minus * c;
+    ++wm.f;
+    --wp.f;
+    int length;
+    generateDigits(w, wp, wp.f - wm.f, buf, length, out_k);
+    return length;
+}
+
+
+int writeExponent(int e, char* buf)
+{
+    int length = 0;
+    buf[length++] = 'e';
+    if(e < 0){
+        buf[length++] = '-';
+        e = -e;
+    }
+    if(e >= 100){
+        buf[length++] = '0' + e / 100;
+        e %= 100;
+        buf[length++] = '0' + e / 10;
+    } else if(e >= 10){
+        buf[length++] = '0' + e / 10;
+    }
+    buf[length++] = '0' + e % 10;
+    return length;
+}
+
+
+// formats digits * 10^k in the plain or the exponential notation
+int formatDigits(char* buf, int length, int k)
+{
+    const int exponent = length + k - 1;
+
+    if(exponent >= 0 && exponent < MAX_PLAIN_EXPONENT){
+        if(k >= 0){
+            // 123e2 -> 12300
+            std::fill(buf + length, buf + length + k, '0');
+            length += k;
+        } else {
+            // 12345e-2 -> 123.45
+            const int point = length + k;
+            std::memmove(buf + point + 1, buf + point, length - point);
+            buf[point] = '.';
+            ++length;
+        }
+    } else if(exponent < 0 && exponent >= MIN_PLAIN_EXPONENT){
+        // 12e-5 -> 0.00012
+        const int offset = 1 - exponent;
+        std::memmove(buf + offset, buf, length);
+        buf[0] = '0';
+        buf[1] = '.';
+        std::fill(buf + 2, buf + offset, '0');
+        length += offset;
+    } else {
+        // 12345e20 -> 1.2345e24
+        if(length > 1){
+            std::memmove(buf + 2, buf + 1, length - 1);
+            buf[1] = '.';
+            ++length;
+        }
+        length += writeExponent(exponent, buf + length);
+    }
+    buf[length] = '\0';
+    return length;
+}
+
+
+int formatInteger(double value, char* buf)
+{
+    long long n = (long long)value;
+    char digits[20];
+    int numDigits = 0;
+    unsigned long long u = (n < 0) ? -n : n;
+    do {
+        digits[numDigits++] = '0' + (u % 10);
+        u /= 10;
+    } while(u);
+
+    int length = 0;
+    // the sign of -0.0 is kept, which is not seen by n
+    if(value < 0.0 || (value == 0.0 && 1.0 / value < 0.0)){
+        buf[length++] = '-';
+    }
+    while(numDigits > 0){
+        buf[length++] = digits[--numDigits];
+    }
+    buf[length] = '\0';
+    return length;
+}
+
+
+/**
+   Writes the shortest digits of the double, or of the float if isFloat is
+   true, in which case the value must be exactly representable as a float.
+*/
+int formatShortest(double value, bool isFloat, char* buf)
+{
+    if(value != value){
+        std::strcpy(buf, "nan");
+        return 3;
+    }
+    int length = 0;
+    if(value < 0.0){
+        buf[length++] = '-';
+        value = -value;
+    }
+    if(value > std::numeric_limits<double>::max()){
+        std::strcpy(buf + length, "inf");
+        return length + 3;
+    }
+
+    int numDigits;
+    int k;
+    if(isFloat){
+        const float f = (float)value;
+        boost::uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        numDigits = grisu2(bits, 23, 8, buf + length, k);
+    } else {
+        boost::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        numDigits = grisu2(bits, 52, 11, buf + length, k);
+    }
+    return length + formatDigits(buf + length, numDigits, k);
+}
+
+
+// printf follows LC_NUMERIC, which may be changed by the GUI toolkit
+void fixDecimalPoint(char* buf, int length)
+{
+    for(int i=0; i < length; ++i){
+        if(buf[i] == ','){
+            buf[i] = '.';
+            break;
+        }
+    }
+}
+
+
+class DoubleNumPut : public std::num_put<char>
+{
+public:
+    DoubleNumPut(int precision) : formatter(precision) { }
+
+    const DoubleFormatter& doubleFormatter() const { return formatter; }
+
+protected:
+    virtual iter_type do_put(iter_type out, std::ios_base& str, char_type fill, double value) const {
+        char buf[DoubleFormatter::BUFFER_SIZE];
+        int length = formatter.format(value, buf);
+        for(streamsize i = str.width(); i > length; --i){
+            *out++ = fill;
+        }
+        str.width(0);
+        for(int i=0; i < length; ++i){
+            *out++ = buf[i];
+        }
+        return out;
+    }
+
+    virtual iter_type do_put(iter_type out, std::ios_base& str, char_type fill, long double value) const {
+        return do_put(out, str, fill, (double)value);
+    }
+
+private:
+    DoubleFormatter formatter;
+};
+
+
+void writeValues(Mapping& archive, const std::string& key, const double* values, int n)
+{
+    DoubleFormatter formatter;
+    Listing* listing = archive.createFlowStyleListing(key);
+    for(int i=0; i < n; ++i){
+        listing->append(formatter.toString(values[i]));
+    }
+}
+
+}
+
+
+int DoubleFormatter::format(double value, char* buf) const
+{
+    if(precision_ > 0){
+        int length = snprintf(buf, BUFFER_SIZE, "%.*g", std::min(precision_, 17), value);
+        fixDecimalPoint(buf, length);
+        return length;
+    }
+    if(value == std::floor(value) && std::fabs(value) < MAX_INTEGER){
+        return formatInteger(value, buf);
+    }
+    return formatShortest(value, false, buf);
+}
+
+
+int DoubleFormatter::formatFloat(float value, char* buf) const
+{
+    if(precision_ > 0 || (value == std::floor(value) && std::fabs(value) < MAX_INTEGER)){
+        return format(value, buf);
+    }
+    return formatShortest(value, true, buf);
+}
+
+
+std::string DoubleFormatter::toString(double value) const
+{
+    char buf[BUFFER_SIZE];
+    int length = format(value, buf);
+    return std::string(buf, length);
+}
+
+
+std::locale DoubleFormatter::locale(int precision)
+{
+    // the facet is deleted by the locale
+    return std::locale(std::locale::classic(), new DoubleNumPut(precision));
+}
+
+
+std::ostream& cnoid::operator<<(std::ostream& os, const FloatText& text)
+{
+    const DoubleNumPut* numPut = dynamic_cast<const DoubleNumPut*>(&std::use_facet<std::num_put<char> >(os.getloc()));
+    if(!numPut){
+        return os << (double)text.value;
+    }
+    char buf[DoubleFormatter::BUFFER_SIZE];
+    const int length = numPut->doubleFormatter().formatFloat(text.value, buf);
+    os.write(buf, length);
+    return os;
+}
+
+
+void cnoid::writeExactly(Mapping& archive, const std::string& key, const Vector3& v)
+{
+    writeValues(archive, key, v.data(), 3);
+}
+
+
+void cnoid::writeExactly(Mapping& archive, const std::string& key, const Matrix3& R)
+{
+    // row major order as write() of EigenArchive
+    double values[9];
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            values[i * 3 + j] = R(i, j);
+        }
+    }
+    writeValues(archive, key, values, 9);
+}
@@ -0,0 +1,77 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_DOUBLE_FORMATTER_H
+#define CNOID_EDITMODEL_PLUGIN_DOUBLE_FORMATTER_H
+
+#include <cnoid/EigenTypes>
+#include <string>
+#include <locale>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Mapping;
+
+/**
+   Converts doubles to text independently of the C locale.
+   With the precision 0, the digits are the shortest ones that are read back
+   as the same value, except for rare cases where one more digit is written.
+   A positive precision limits the number of the significant digits.
+*/
+class CNOID_EXPORT DoubleFormatter
+{
+public:
+    enum { BUFFER_SIZE = 32 };
+
+    DoubleFormatter(int precision = 0) : precision_(precision) { }
+
+    void setPrecision(int precision) { precision_ = precision; }
+    int precision() const { return precision_; }
+
+    /// buf must have BUFFER_SIZE bytes. The length of the text is returned.
+    int format(double value, char* buf) const;
+
+    /**
+       Formats a value which is known to be a float, such as a color or a
+       mesh vertex, with the shortest digits which are read back as the
+       same float. These digits may not be read back as the same double.
+    */
+    int formatFloat(float value, char* buf) const;
+    std::string toString(double value) const;
+
+    /**
+       Locale whose doubles are written by a formatter of the precision.
+       The other numbers are written in the classic locale.
+    */
+    static std::locale locale(int precision = 0);
+
+private:
+    int precision_;
+};
+
+/**
+   Alternatives to write() of EigenArchive which do not lose digits.
+   The elements are stored as plain scalars, so they are read by read().
+*/
+CNOID_EXPORT void writeExactly(Mapping& archive, const std::string& key, const Vector3& v);
+CNOID_EXPORT void writeExactly(Mapping& archive, const std::string& key, const Matrix3& R);
+
+/**
+   Writes a float with DoubleFormatter::formatFloat() to a stream imbued
+   with DoubleFormatter::locale(), as os << FloatText(color[0]).
+   Other streams get the value as a double.
+*/
+struct FloatText
+{
+    float value;
+    explicit FloatText(float value) : value(value) { }
+};
+
+CNOID_EXPORT std::ostream& operator<<(std::ostream& os, const FloatText& text);
+
+}
+
+#endif
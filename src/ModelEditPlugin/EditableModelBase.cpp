@@ -3,6 +3,8 @@
 */
 
 #include "EditableModelBase.h"
+#include "PoseTable.h"
+#include "ModelUpdateScheduler.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
 #include <boost/bind.hpp>
@@ -49,6 +51,50 @@ EditableModelBase::EditableModelBase()
 }
 
 
+EditableModelBase::EditableModelBase(const EditableModelBase& org)
+    : Item(org),
+      originalNode(org.originalNode),
+      translation(org.translation),
+      absTranslation(org.absTranslation),
+      rotation(org.rotation),
+      absRotation(org.absRotation)
+{
+
+}
+
+
+EditableModelBase::~EditableModelBase()
+{
+    ModelUpdateScheduler::instance()->cancel(this);
+}
+
+
+PoseTable* EditableModelBase::poseTable()
+{
+    EditableModelBase* root = this;
+    while(true){
+        EditableModelBase* parent = dynamic_cast<EditableModelBase*>(root->parentItem());
+        if(!parent){
+            break;
+        }
+        root = parent;
+    }
+    if(!root->poseTable_){
+        root->poseTable_.reset(new PoseTable(root));
+        root->poseTableConnection = root->sigSubTreeChanged().connect(
+            boost::bind(&EditableModelBase::resetPoseTable, root));
+    }
+    return root->poseTable_.get();
+}
+
+
+void EditableModelBase::resetPoseTable()
+{
+    poseTableConnection.disconnect();
+    poseTable_.reset();
+}
+
+
 void EditableModelBase::doPutProperties(PutPropertyFunction& putProperty)
 {
     ostringstream oss;
@@ -71,12 +117,9 @@ void EditableModelBase::doPutProperties(PutPropertyFunction& putProperty)
 
 void EditableModelBase::updateChildPositions()
 {
-    for(Item* child = childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item){
-            item->updatePosition();
-        }
-    }
+    PoseTable* table = poseTable();
+    table->markChildrenDirty(this);
+    table->flush();
 }
 
 bool EditableModelBase::onTranslationChanged(const std::string& value)
@@ -141,15 +184,8 @@ bool EditableModelBase::onRotationRPYChanged(const std::string& value)
 
 void EditableModelBase::updatePosition()
 {
-    EditableModelBase *parent;
-    parent = dynamic_cast<EditableModelBase*>(parentItem());
-    if (parent){
-        absTranslation = parent->absRotation*translation + parent->absTranslation;
-        absRotation = parent->absRotation*rotation;
-    }else{
-        absTranslation = translation;
-        absRotation = rotation;
-    }
-    updateChildPositions();
+    PoseTable* table = poseTable();
+    table->markDirty(this);
+    table->flush();
     notifyUpdate();
 }
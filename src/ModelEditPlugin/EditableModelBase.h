@@ -8,21 +8,37 @@
 #include <cnoid/Item>
 #include <cnoid/VRML>
 #include <cnoid/EigenTypes>
+#include <cnoid/Signal>
+#include <boost/shared_ptr.hpp>
 #include "exportdecl.h"
 
 namespace cnoid {
 
 std::vector<double> readvector(const std::string& value);
 
+class SgPosTransform;
+class PoseTable;
+class VRMLModelWriter;
+class URDFWriter;
+class SDFWriter;
+class GLBWriter;
+struct ModelSnapshotRecord;
+class ModelSnapshotWriter;
+class ModelSnapshotReader;
+
 class CNOID_EXPORT EditableModelBase : public Item
 {
 public:
     EditableModelBase();
+    EditableModelBase(const EditableModelBase& org);
+    virtual ~EditableModelBase();
     VRMLNodePtr originalNode;
     Vector3 translation, absTranslation;
     Matrix3 rotation, absRotation;
-    virtual VRMLNodePtr toVRML() { return NULL; };
-    virtual std::string toURDF() { return ""; };
+    virtual void writeVRML(VRMLModelWriter& writer) { }
+    virtual void writeURDF(URDFWriter& writer) { }
+    virtual void writeSDF(SDFWriter& writer) { }
+    virtual void writeGLB(GLBWriter& writer) { }
     bool onTranslationChanged(const std::string& value);
     bool onRotationChanged(const std::string& value);
     bool onRotationAxisChanged(const std::string& value);
@@ -30,6 +46,29 @@ public:
     void doPutProperties(PutPropertyFunction& putProperty);
     void updateChildPositions();
     void updatePosition();
+
+    /**
+       Scene node placed at absTranslation and absRotation. The pose table
+       writes it directly instead of calling notifyUpdate() for the
+       descendants of a moved item, whose poses are derived from their parents.
+    */
+    virtual SgPosTransform* sceneTransform() { return 0; }
+
+    /**
+       Stores the parameters of the item other than the name and the local
+       pose, which are stored by the writer. Returns false if the item
+       cannot be stored in a snapshot.
+    */
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer) { return false; }
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader) { }
+
+    /// table of the tree which this item belongs to, owned by the root item
+    PoseTable* poseTable();
+
+private:
+    boost::shared_ptr<PoseTable> poseTable_;
+    Connection poseTableConnection;
+    void resetPoseTable();
 };
 
 }
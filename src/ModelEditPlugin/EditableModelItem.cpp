@@ -9,6 +9,15 @@
 #include "SensorItem.h"
 #include "PrimitiveShapeItem.h"
 #include "MeshShapeItem.h"
+#include "MeshCache.h"
+#include "SelectionTracker.h"
+#include "ModelSnapshot.h"
+#include "ModelUpdateScheduler.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include "GLBWriter.h"
+#include "ModelFileStream.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
@@ -21,6 +30,7 @@
 #include <cnoid/OptionManager>
 #include <cnoid/MenuManager>
 #include <cnoid/PutPropertyFunction>
+#include <cnoid/ConnectionSet>
 #include <cnoid/JointPath>
 #include <cnoid/BodyLoader>
 #include <cnoid/VRMLBodyLoader>
@@ -31,17 +41,20 @@
 #include <cnoid/VRMLBody>
 #include <cnoid/VRMLBodyWriter>
 #include <cnoid/FileUtil>
-#include <sdf/sdf.hh>
-#include <sdf/parser_urdf.hh>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/variant.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 #include <bitset>
 #include <deque>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <set>
+#include <cctype>
 #include "gettext.h"
 
 using namespace std;
@@ -65,6 +78,27 @@ bool loadEditableModelItem(EditableModelItem* item, const std::string& filename)
 }
 
 
+bool loadEditableModelItemInBackground(EditableModelItem* item, const std::string& filename)
+{
+    return item->loadModelFileInBackground(filename);
+}
+
+
+void cancelAllModelLoading();
+
+
+bool loadEditableModelItemSnapshot(EditableModelItem* item, const std::string& filename)
+{
+    return item->loadSnapshot(filename);
+}
+
+
+bool saveEditableModelItemSnapshot(EditableModelItem* item, const std::string& filename)
+{
+    return item->saveSnapshot(filename);
+}
+
+
 bool saveEditableModelItem(EditableModelItem* item, const std::string& filename)
 {
     if(item->saveModelFile(filename)){
@@ -81,6 +115,12 @@ bool saveEditableModelItemURDF(EditableModelItem* item, const std::string& filen
     return false;
 }
 
+bool saveEditableModelItemGLB(EditableModelItem* item, const std::string& filename)
+{
+    return item->saveModelFileGLB(filename);
+}
+
+
 bool saveEditableModelItemSDF(EditableModelItem* item, const std::string& filename)
 {
     if(item->saveModelFileSDF(filename)){
@@ -94,26 +134,80 @@ bool saveEditableModelItemSDF(EditableModelItem* item, const std::string& filena
 
 namespace cnoid {
 
+class EditableModelItemImpl;
+
+/**
+   State of a model loading. The body parsed by the loading thread is kept
+   here until the items are built from it and attached in the main thread.
+*/
+class ModelLoadTask
+{
+public:
+    string filename;
+    // reset when the item is deleted during the loading
+    EditableModelItemImpl* impl;
+    BodyPtr body;
+    AbstractBodyLoaderPtr loader;
+    string messages;
+    EditableModelItemPtr container;
+    vector<ItemPtr> checkedItems;
+    // first item of each name in the preorder, used instead of findItem
+    boost::unordered_map<string, Item*> itemsByName;
+
+    ModelLoadTask(const string& filename)
+        : filename(filename), impl(0), isCanceled_(false) { }
+
+    void addToNameIndex(Item* item) { itemsByName.insert(make_pair(item->name(), item)); }
+    bool isCanceled();
+    void cancel();
+
+private:
+    boost::mutex mutex;
+    bool isCanceled_;
+};
+
+typedef boost::shared_ptr<ModelLoadTask> ModelLoadTaskPtr;
+
 class EditableModelItemImpl
 {
 public:
     EditableModelItem* self;
+    ModelLoadTaskPtr loadTask;
+
+    typedef boost::unordered_map<string, Item*> NameIndex;
+    NameIndex nameIndex;
+    bool isNameIndexValid;
+    Connection subTreeChangedConnection;
+    ConnectionSet nameChangedConnections;
+    // the model file recorded in the project when the items have been
+    // restored from a snapshot, which does not set the file of the item
+    string restoredModelFile;
+    // the snapshot written into the project directory, which is reused by
+    // the next store of the project
+    string projectSnapshotFile;
 
     EditableModelItemImpl(EditableModelItem* self);
     EditableModelItemImpl(EditableModelItem* self, const EditableModelItemImpl& org);
     ~EditableModelItemImpl();
     
     bool loadModelFile(const std::string& filename);
+    bool loadModelFile(const std::string& filename, BodyLoader& loader, std::ostream& os);
+    bool loadModelFileInBackground(const std::string& filename);
+    void cancelModelLoading();
+    void attachItemTree(ModelLoadTask* task);
+    void invalidateNameIndex();
+    void updateNameIndex();
+    Item* findItemByName(const std::string& name);
+    bool loadSnapshot(const std::string& filename);
+    bool saveSnapshot(const std::string& filename);
     bool saveModelFile(const std::string& filename);
     bool saveModelFileURDF(const std::string& filename);
     bool saveModelFileSDF(const std::string& filename);
-    VRMLNodePtr toVRML();
-    string toURDF();
-    void setLinkTree(Link* link, VRMLBodyLoader* vloader);
-    void setLinkTreeSub(Link* link, VRMLBodyLoader* vloader, Item* parentItem);
+    bool saveModelFileGLB(const std::string& filename);
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
+    bool storeSnapshot(Archive& archive);
     bool restore(const Archive& archive);
 };
 
@@ -129,12 +223,32 @@ void EditableModelItem::initializeClass(ExtensionManager* ext)
         ext->itemManager().addCreationPanel<EditableModelItem>();
         ext->itemManager().addLoader<EditableModelItem>(
             _("OpenHRP Model File for Editing"), "OpenHRP-VRML-MODEL", "wrl;dae;stl", boost::bind(loadEditableModelItem, _1, _2));
+        ext->itemManager().addLoader<EditableModelItem>(
+            _("OpenHRP Model File for Editing (Background)"), "OpenHRP-VRML-MODEL-BACKGROUND", "wrl;dae;stl",
+            boost::bind(loadEditableModelItemInBackground, _1, _2));
+        ext->itemManager().addLoader<EditableModelItem>(
+            _("Compressed OpenHRP Model File for Editing"), "OpenHRP-VRML-MODEL-GZIP", "wrl.gz",
+            boost::bind(loadEditableModelItem, _1, _2));
+        ext->itemManager().addLoader<EditableModelItem>(
+            _("Model Edit Snapshot"), "MODEL-EDIT-SNAPSHOT", "mesnap", boost::bind(loadEditableModelItemSnapshot, _1, _2));
         ext->itemManager().addSaver<EditableModelItem>(
             _("OpenHRP Model File"), "OpenHRP-VRML-MODEL", "wrl", boost::bind(saveEditableModelItem, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("Compressed OpenHRP Model File"), "OpenHRP-VRML-MODEL-GZIP", "wrl.gz",
+            boost::bind(saveEditableModelItem, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("Model Edit Snapshot"), "MODEL-EDIT-SNAPSHOT", "mesnap", boost::bind(saveEditableModelItemSnapshot, _1, _2));
         ext->itemManager().addSaver<EditableModelItem>(
             _("URDF Model File"), "URDF-MODEL", "urdf", boost::bind(saveEditableModelItemURDF, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("Compressed URDF Model File"), "URDF-MODEL-GZIP", "urdf.gz",
+            boost::bind(saveEditableModelItemURDF, _1, _2));
         ext->itemManager().addSaver<EditableModelItem>(
             _("SDF Model File"), "SDF-MODEL", "sdf", boost::bind(saveEditableModelItemSDF, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("glTF Binary File"), "GLB-MODEL", "glb", boost::bind(saveEditableModelItemGLB, _1, _2));
+        ext->menuManager().setPath("/File").addItem(_("Cancel Model Loading"))
+            ->sigTriggered().connect(cancelAllModelLoading);
         initialized = true;
     }
 }
@@ -149,6 +263,9 @@ EditableModelItem::EditableModelItem()
 EditableModelItemImpl::EditableModelItemImpl(EditableModelItem* self)
     : self(self)
 {
+    isNameIndexValid = false;
+    subTreeChangedConnection = self->sigSubTreeChanged().connect(
+        boost::bind(&EditableModelItemImpl::invalidateNameIndex, this));
 }
 
 
@@ -162,6 +279,9 @@ EditableModelItem::EditableModelItem(const EditableModelItem& org)
 EditableModelItemImpl::EditableModelItemImpl(EditableModelItem* self, const EditableModelItemImpl& org)
     : self(self)
 {
+    isNameIndexValid = false;
+    subTreeChangedConnection = self->sigSubTreeChanged().connect(
+        boost::bind(&EditableModelItemImpl::invalidateNameIndex, this));
 }
 
 
@@ -173,15 +293,15 @@ EditableModelItem::~EditableModelItem()
 
 EditableModelItemImpl::~EditableModelItemImpl()
 {
+    subTreeChangedConnection.disconnect();
+    nameChangedConnections.disconnect();
+    if (loadTask) {
+        loadTask->impl = 0;
+        loadTask->cancel();
+    }
 }
 
 
-void EditableModelItemImpl::setLinkTree(Link* link, VRMLBodyLoader* vloader)
-{
-    setLinkTreeSub(link, vloader, self);
-    self->notifyUpdate();
-}
-
 void showSgNodeTree(SgNode *node, int indent)
 {
     SgGroup *group = dynamic_cast<SgGroup *>(node);
@@ -256,8 +376,13 @@ void createShapeItems(LinkItem *linkItem, SgNode *snode, VRMLNode *vnode,
     VRMLInline *inlineNode = dynamic_cast<VRMLInline *>(vnode);
     if (inlineNode){
         //std::cout << "VRMLInline" << std::endl;
+        // the files have been loaded into the cache by collectInlineUrls and preload
+        SgNode* node = MeshCache::instance()->find(inlineNode->urls[0]);
+        if (!node) {
+            node = snode;
+        }
         MeshShapeItemPtr mesh
-            = new MeshShapeItem(translation, rotation, snode, inlineNode->urls[0]);
+            = new MeshShapeItem(translation, rotation, node, inlineNode->urls[0]);
         linkItem->addChildItem(mesh);
         return;
     }
@@ -341,25 +466,61 @@ void createShapeItems(LinkItem *linkItem, SgNode *snode, VRMLNode *vnode,
     }
 }
 
-void EditableModelItemImpl::setLinkTreeSub(Link* link, VRMLBodyLoader* vloader, Item* parentItem)
+void collectInlineUrls(VRMLNode *vnode, vector<string>& urls)
+{
+    VRMLInline *inlineNode = dynamic_cast<VRMLInline *>(vnode);
+    if (inlineNode){
+        if (!inlineNode->urls.empty()){
+            urls.push_back(inlineNode->urls[0]);
+        }
+        return;
+    }
+
+    VRMLProtoInstance *proto = dynamic_cast<VRMLProtoInstance *>(vnode);
+    if (proto){
+        if (proto->proto->protoName != "Segment") return;
+        MFNode children = boost::get<MFNode>(proto->fields["children"]);
+        for (unsigned int i=0; i<children.size(); i++){
+            collectInlineUrls(children[i].get(), urls);
+        }
+        return;
+    }
+
+    VRMLTransform *vtrans = dynamic_cast<VRMLTransform *>(vnode);
+    if (vtrans){
+        for (int i=0; i<vtrans->countChildren(); i++){
+            collectInlineUrls(vtrans->getChild(i), urls);
+        }
+        return;
+    }
+}
+
+
+void setLinkTreeSub(Link* link, VRMLBodyLoader* vloader, Item* parentItem, ModelLoadTask* task)
 {
+    if (task->isCanceled()) {
+        return;
+    }
     // first, create joint item
     JointItemPtr item = new JointItem(link);
     //item->originalNode = vloader->getOriginalNode(link);
     parentItem->addChildItem(item);
-    ItemTreeView::instance()->checkItem(item, true);
+    task->checkedItems.push_back(item);
+    task->addToNameIndex(item);
     SgNode* visualShape = link->visualShape();
     link->setVisualShape(NULL);
     // next, create link item under the joint item
     LinkItemPtr litem = new LinkItem(link);
     //litem->originalNode = vloader->getOriginalNode(link);
     item->addChildItem(litem);
+    task->addToNameIndex(litem);
     SgNode* collisionShape = link->collisionShape();
     if (collisionShape != visualShape) {
         LinkItemPtr citem = new LinkItem(link);
         //citem->originalNode = vloader->getOriginalNode(link);
         citem->setName("collision");
         litem->addChildItem(citem);
+        task->addToNameIndex(citem);
     }
 #if 0
     std::cout << link->name() << std::endl;
@@ -368,15 +529,180 @@ void EditableModelItemImpl::setLinkTreeSub(Link* link, VRMLBodyLoader* vloader,
 #endif
     createShapeItems(litem, visualShape, vloader->getOriginalNode(link).get(),
                      Vector3::Zero(), link->Rs().transpose());
-    ItemTreeView::instance()->checkItem(litem, true);
+    task->checkedItems.push_back(litem);
 
     if(link->child()){
         for(Link* child = link->child(); child; child = child->sibling()){
-            setLinkTreeSub(child, vloader, item);
+            setLinkTreeSub(child, vloader, item, task);
+        }
+    }
+}
+
+
+/**
+   Builds the items of the loaded body under task->container, which is not
+   connected to the item tree. The items attach the scene nodes shared by
+   SharedShapes and MeshCache, so this must be called by the main thread.
+*/
+bool buildItemTree(ModelLoadTask* task)
+{
+    Body* body = task->body;
+    body->initializeState();
+    body->calcForwardKinematics();
+    Link* link = body->rootLink();
+
+    task->container = new EditableModelItem;
+
+    VRMLBodyLoader* vloader = dynamic_cast<VRMLBodyLoader*>(task->loader.get());
+    if (vloader) {
+        // VRMLBodyLoader supports retriveOriginalNode function
+        // the inline meshes are loaded in parallel before the items are created
+        vector<string> urls;
+        for (int i = 0; i < body->numLinks(); i++) {
+            collectInlineUrls(vloader->getOriginalNode(body->link(i)).get(), urls);
         }
+        MeshCache::instance()->preload(urls);
+        setLinkTreeSub(link, vloader, task->container, task);
+    } else {
+        // Other loaders dont, so we wrap with inline node
+        VRMLProtoInstance* proto = new VRMLProtoInstance(new VRMLProto(""));
+        MFNode* children = new MFNode();
+        VRMLInlinePtr inl = new VRMLInline();
+        inl->urls.push_back(task->filename);
+        children->push_back(inl);
+        proto->fields["children"] = *children;
+        // first, create joint item
+        JointItemPtr item = new JointItem(link);
+        item->originalNode = proto;
+        task->container->addChildItem(item);
+        task->checkedItems.push_back(item);
+        task->addToNameIndex(item);
+        // next, create link item under the joint item
+        LinkItemPtr litem = new LinkItem(link);
+        litem->originalNode = proto;
+        litem->setName("link");
+        item->addChildItem(litem);
+        task->checkedItems.push_back(litem);
+        task->addToNameIndex(litem);
+    }
+    if (task->isCanceled()) {
+        return false;
+    }
+    for (int i = 0; i < body->numDevices(); i++) {
+        Device* dev = body->device(i);
+        SensorItemPtr sitem = new SensorItem(dev);
+        boost::unordered_map<string, Item*>::iterator p = task->itemsByName.find(dev->link()->name());
+        Item* parent = (p != task->itemsByName.end()) ? p->second : 0;
+        if (parent) {
+            parent->addChildItem(sitem);
+            task->checkedItems.push_back(sitem);
+        }
+    }
+    return !task->isCanceled();
+}
+
+
+/**
+   Parses task->filename with the loader. A compressed file is decompressed
+   to a temporary file of the system first, which is removed after the
+   parsing. Only VRML files can be compressed, because the other loaders
+   are given the original files.
+*/
+void loadBody(ModelLoadTask* task, BodyLoader& loader, ostream& os)
+{
+    DecompressedModelFile decompressed;
+    string filename = task->filename;
+    if(isGzipFilename(filename)){
+        // the items of the other loaders refer to the file itself
+        if(getExtension(filesystem::path(removeGzipExtension(filename))) != "wrl"){
+            os << "Only VRML files can be loaded from \"" << filename << "\"." << endl;
+            return;
+        }
+        if(!decompressed.decompress(filename, os)){
+            return;
+        }
+        filename = decompressed.filename();
+    }
+    loader.setMessageSink(os);
+    task->body = loader.load(filename);
+    task->loader = loader.lastActualBodyLoader();
+}
+
+
+bool ModelLoadTask::isCanceled()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return isCanceled_;
+}
+
+
+void ModelLoadTask::cancel()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    isCanceled_ = true;
+}
+
+
+namespace {
+
+set<ModelLoadTaskPtr> runningLoadTasks;
+
+void finishLoadTask(ModelLoadTaskPtr task)
+{
+    runningLoadTasks.erase(task);
+
+    MessageView* mv = MessageView::instance();
+    if (!task->messages.empty()) {
+        mv->put(task->messages);
+    }
+    EditableModelItemImpl* impl = task->impl;
+    if (impl && impl->loadTask == task) {
+        impl->loadTask.reset();
+    }
+    if (task->isCanceled()) {
+        mv->putln(string("Loading \"") + task->filename + "\" has been canceled.");
+    } else if (!task->body) {
+        mv->putln(string("Loading \"") + task->filename + "\" failed.");
+    } else if (impl) {
+        mv->putln(string("Loading \"") + task->filename + "\": building the items");
+        if (buildItemTree(task.get())) {
+            impl->attachItemTree(task.get());
+            mv->putln(string("Loading \"") + task->filename + "\" has been finished.");
+        }
+    }
+
+    // the items are released in the main thread
+    task->checkedItems.clear();
+    task->container = 0;
+    task->loader = 0;
+    task->body = 0;
+}
+
+
+void runLoadTask(ModelLoadTaskPtr task)
+{
+    if (!task->isCanceled()) {
+        // the global loader is used by the main thread
+        BodyLoader loader;
+        ostringstream messages;
+        loadBody(task.get(), loader, messages);
+        task->messages = messages.str();
+    }
+    // the items are built by the main thread
+    callLater(boost::bind(finishLoadTask, task));
+}
+
+
+void cancelAllModelLoading()
+{
+    for (set<ModelLoadTaskPtr>::iterator p = runningLoadTasks.begin(); p != runningLoadTasks.end(); ++p) {
+        (*p)->cancel();
     }
 }
 
+}
+
+
 bool EditableModelItem::loadModelFile(const std::string& filename)
 {
     return impl->loadModelFile(filename);
@@ -385,113 +711,216 @@ bool EditableModelItem::loadModelFile(const std::string& filename)
 
 bool EditableModelItemImpl::loadModelFile(const std::string& filename)
 {
-    BodyPtr newBody;
-
     MessageView* mv = MessageView::instance();
     mv->beginStdioRedirect();
+    bool loaded = loadModelFile(filename, bodyLoader, mv->cout(true));
+    mv->endStdioRedirect();
+    return loaded;
+}
 
-    bodyLoader.setMessageSink(mv->cout(true));
-    newBody = bodyLoader.load(filename);
 
-    mv->endStdioRedirect();
-    
-    if(newBody){
-        newBody->initializeState();
-        newBody->calcForwardKinematics();
-        Link* link = newBody->rootLink();
-        
-        AbstractBodyLoaderPtr loader = bodyLoader.lastActualBodyLoader();
-        VRMLBodyLoader* vloader = dynamic_cast<VRMLBodyLoader*>(loader.get());
-        if (vloader) {
-            // VRMLBodyLoader supports retriveOriginalNode function
-            setLinkTree(link, vloader);
+bool EditableModelItem::loadModelFile(const std::string& filename, std::ostream& os)
+{
+    // the global loader is used by the main thread
+    BodyLoader loader;
+    return impl->loadModelFile(filename, loader, os);
+}
+
+
+bool EditableModelItemImpl::loadModelFile(const std::string& filename, BodyLoader& loader, std::ostream& os)
+{
+    ModelLoadTask task(filename);
+    loadBody(&task, loader, os);
+
+    if(task.body){
+        buildItemTree(&task);
+        attachItemTree(&task);
+    }
+
+    return (task.body);
+}
+
+
+bool EditableModelItem::loadModelFileInBackground(const std::string& filename)
+{
+    return impl->loadModelFileInBackground(filename);
+}
+
+
+/**
+   Parses the file in a separate thread. The items are built from the parsed
+   body and attached to this item in the main thread.
+*/
+bool EditableModelItemImpl::loadModelFileInBackground(const std::string& filename)
+{
+    cancelModelLoading();
+
+    loadTask.reset(new ModelLoadTask(filename));
+    loadTask->impl = this;
+    runningLoadTasks.insert(loadTask);
+
+    MessageView::instance()->putln(string("Loading \"") + filename + "\" in background ...");
+
+    boost::thread thread(boost::bind(runLoadTask, loadTask));
+    thread.detach();
+
+    return true;
+}
+
+
+void EditableModelItem::cancelModelLoading()
+{
+    impl->cancelModelLoading();
+}
+
+
+void EditableModelItemImpl::cancelModelLoading()
+{
+    if (loadTask) {
+        loadTask->cancel();
+        loadTask.reset();
+    }
+}
+
+
+Item* EditableModelItem::findItemByName(const std::string& name) const
+{
+    return impl->findItemByName(name);
+}
+
+
+Item* EditableModelItemImpl::findItemByName(const std::string& name)
+{
+    if (!isNameIndexValid) {
+        updateNameIndex();
+    }
+    NameIndex::iterator p = nameIndex.find(name);
+    if (p != nameIndex.end()) {
+        return p->second;
+    }
+    return 0;
+}
+
+
+void EditableModelItemImpl::invalidateNameIndex()
+{
+    isNameIndexValid = false;
+}
+
+
+/**
+   Indexes the descendants in preorder, so that a name shared by several
+   items gives the same item as findItem.
+*/
+void EditableModelItemImpl::updateNameIndex()
+{
+    nameIndex.clear();
+    nameChangedConnections.disconnect();
+
+    Item* item = self->childItem();
+    while (item) {
+        nameIndex.insert(make_pair(item->name(), item));
+        nameChangedConnections.add(
+            item->sigNameChanged().connect(
+                boost::bind(&EditableModelItemImpl::invalidateNameIndex, this)));
+        if (item->childItem()) {
+            item = item->childItem();
         } else {
-            // Other loaders dont, so we wrap with inline node
-            VRMLProtoInstance* proto = new VRMLProtoInstance(new VRMLProto(""));
-            MFNode* children = new MFNode();
-            VRMLInlinePtr inl = new VRMLInline();
-            inl->urls.push_back(filename);
-            children->push_back(inl);
-            proto->fields["children"] = *children;
-            // first, create joint item
-            JointItemPtr item = new JointItem(link);
-            item->originalNode = proto;
-            self->addChildItem(item);
-            ItemTreeView::instance()->checkItem(item, true);
-            // next, create link item under the joint item
-            LinkItemPtr litem = new LinkItem(link);
-            litem->originalNode = proto;
-            litem->setName("link");
-            item->addChildItem(litem);
-            ItemTreeView::instance()->checkItem(litem, true);
-        }
-        for (int i = 0; i < newBody->numDevices(); i++) {
-            Device* dev = newBody->device(i);
-            SensorItemPtr sitem = new SensorItem(dev);
-            Item* parent = self->findItem<Item>(dev->link()->name());
-            if (parent) {
-                parent->addChildItem(sitem);
-                ItemTreeView::instance()->checkItem(sitem, true);
+            while (item && item != self && !item->nextItem()) {
+                item = item->parentItem();
             }
+            item = (item && item != self) ? item->nextItem() : 0;
         }
-        JointItem *rootJoint = dynamic_cast<JointItem*>(self->childItem());
-        if (rootJoint) rootJoint->updatePosition();
     }
+    isNameIndexValid = true;
+}
+
 
-    return (newBody);
+bool EditableModelItem::isLoadingModel() const
+{
+    return impl->loadTask.get() != 0;
 }
 
 
-VRMLNodePtr EditableModelItemImpl::toVRML()
+/**
+   Attaches the detached items built by buildItemTree. The selection handlers
+   of the existing items are not invoked for each insertion and check.
+   Without the item tree view, e.g. in a command line tool, the items are
+   only attached.
+*/
+void EditableModelItemImpl::attachItemTree(ModelLoadTask* task)
 {
-    VRMLHumanoidPtr node;
-    node = new VRMLHumanoid();
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            VRMLNodePtr childnode = item->toVRML();
-            node->humanoidBody.push_back(childnode);
+    ItemTreeView* itemTreeView = ItemTreeView::instance();
+    SelectionTracker* tracker = itemTreeView ? SelectionTracker::instance() : 0;
+    if(tracker){
+        tracker->blockUpdates();
+    }
+
+    vector<ItemPtr> children;
+    for(Item* child = task->container->childItem(); child; child = child->nextItem()){
+        children.push_back(child);
+    }
+    for(size_t i=0; i < children.size(); ++i){
+        children[i]->detachFromParentItem();
+        self->addChildItem(children[i]);
+    }
+    if(tracker){
+        for(size_t i=0; i < task->checkedItems.size(); ++i){
+            itemTreeView->checkItem(task->checkedItems[i], true);
         }
+        tracker->unblockUpdates();
+    }
+    self->notifyUpdate();
+
+    for(size_t i=0; i < children.size(); ++i){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(children[i].get());
+        if (item) item->updatePosition();
     }
-    return node;
 }
 
 
-string EditableModelItemImpl::toURDF()
+bool EditableModelItem::loadSnapshot(const std::string& filename)
 {
-    ostringstream ss;
-    ss << "<robot name=\"" << self->name() << "\">" << endl;
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            ss << item->toURDF();
-        }
+    return impl->loadSnapshot(filename);
+}
+
+
+bool EditableModelItemImpl::loadSnapshot(const std::string& filename)
+{
+    ModelLoadTask task(filename);
+    task.container = new EditableModelItem;
+
+    ModelSnapshotReader reader;
+    if (!reader.read(filename, task.container, task.checkedItems, MessageView::instance()->cout())) {
+        return false;
     }
-    ss << "</robot>" << endl;
-    return ss.str();
+    attachItemTree(&task);
+    return true;
 }
 
 
-bool EditableModelItem::saveModelFile(const std::string& filename)
+bool EditableModelItem::saveSnapshot(const std::string& filename)
 {
-    return impl->saveModelFile(filename);
+    return impl->saveSnapshot(filename);
 }
 
 
-bool EditableModelItemImpl::saveModelFile(const std::string& filename)
+bool EditableModelItemImpl::saveSnapshot(const std::string& filename)
 {
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    VRMLBodyWriter* writer = new VRMLBodyWriter(of);
-    writer->setOutFileName(filename);
-    writer->writeHeader();
+    ModelSnapshotWriter writer;
+    return writer.write(self, filename, MessageView::instance()->cout());
+}
 
-    of << endl;
 
-    writer->writeOpenHRPPROTOs();
-    writer->writeNode(toVRML());
+bool EditableModelItem::saveModelFile(const std::string& filename)
+{
+    return impl->saveModelFile(filename);
+}
 
-    return true;
+
+bool EditableModelItemImpl::saveModelFile(const std::string& filename)
+{
+    return VRMLModelWriter::save(self, filename);
 }
 
 
@@ -503,11 +932,7 @@ bool EditableModelItem::saveModelFileURDF(const std::string& filename)
 
 bool EditableModelItemImpl::saveModelFileURDF(const std::string& filename)
 {
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    of << toURDF();
-    of.close();
-    return true;
+    return URDFWriter::save(self, filename, MessageView::instance()->cout());
 }
 
 
@@ -519,15 +944,23 @@ bool EditableModelItem::saveModelFileSDF(const std::string& filename)
 
 bool EditableModelItemImpl::saveModelFileSDF(const std::string& filename)
 {
-    sdf::SDFPtr robot(new sdf::SDF());
-    sdf::init(robot);
-    sdf::readString(toURDF(), robot);
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    of << robot->ToString();
-    cout << robot->ToString() << endl;
-    of.close();
-    return true;
+    return SDFWriter::save(self, filename, MessageView::instance()->cout());
+}
+
+
+bool EditableModelItem::saveModelFileGLB(const std::string& filename)
+{
+    return impl->saveModelFileGLB(filename);
+}
+
+
+bool EditableModelItemImpl::saveModelFileGLB(const std::string& filename)
+{
+    // the GLB file is written from the scene meshes, which are regenerated
+    // by the pending updates. The scheduler belongs to the main thread, so
+    // it is flushed here rather than by the writer used by the converter.
+    ModelUpdateScheduler::instance()->flush();
+    return GLBWriter::save(self, filename);
 }
 
 
@@ -570,8 +1003,46 @@ bool EditableModelItem::store(Archive& archive)
 
 bool EditableModelItemImpl::store(Archive& archive)
 {
-    archive.writeRelocatablePath("modelFile", self->filePath());
+    string modelFile = self->filePath();
+    if (modelFile.empty()) {
+        modelFile = restoredModelFile;
+    }
+    archive.writeRelocatablePath("modelFile", modelFile);
+    storeSnapshot(archive);
+
+    return true;
+}
 
+
+/**
+   The edited state is written as a snapshot in the project directory and
+   the project refers to it, so the edits which the model file cannot hold
+   are kept and the model file is not parsed again when the project is
+   opened. The model file may be read-only, so nothing is written next to it.
+*/
+bool EditableModelItemImpl::storeSnapshot(Archive& archive)
+{
+    const string projectDirectory = archive.expandPathVariables("${PROJECT_DIR}");
+    if (projectDirectory.empty() || projectDirectory.find("${") != string::npos) {
+        return false;
+    }
+    filesystem::path directory(projectDirectory);
+    if (projectSnapshotFile.empty() ||
+        filesystem::path(projectSnapshotFile).parent_path() != directory) {
+        string name = self->name();
+        for (size_t i=0; i < name.size(); ++i) {
+            if (!isalnum(static_cast<unsigned char>(name[i])) && name[i] != '-' && name[i] != '_') {
+                name[i] = '_';
+            }
+        }
+        projectSnapshotFile =
+            (directory / filesystem::unique_path(name + "-%%%%%%%%.mesnap")).string();
+    }
+    if (!saveSnapshot(projectSnapshotFile)) {
+        projectSnapshotFile.clear();
+        return false;
+    }
+    archive.writeRelocatablePath("snapshotFile", projectSnapshotFile);
     return true;
 }
 
@@ -587,7 +1058,16 @@ bool EditableModelItemImpl::restore(const Archive& archive)
     bool restored = false;
     
     string modelFile;
-    if(archive.readRelocatablePath("modelFile", modelFile)){
+    archive.readRelocatablePath("modelFile", modelFile);
+
+    // the model file is only parsed when the project has no snapshot
+    string snapshotFile;
+    if(archive.readRelocatablePath("snapshotFile", snapshotFile) && loadSnapshot(snapshotFile)){
+        projectSnapshotFile = snapshotFile;
+        restoredModelFile = modelFile;
+        restored = true;
+    }
+    if(!restored && !modelFile.empty()){
         restored = self->load(modelFile);
     }
 
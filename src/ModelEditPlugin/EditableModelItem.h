@@ -10,6 +10,7 @@
 #include <cnoid/Link>
 #include <cnoid/SceneProvider>
 #include <boost/optional.hpp>
+#include <iosfwd>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -28,9 +29,25 @@ public:
     virtual ~EditableModelItem();
 
     bool loadModelFile(const std::string& filename);
+    /**
+       Loads the model without the views of the GUI. The messages of the loader
+       are written to os. The items share scene nodes with the other items, so
+       the models must be loaded and released by one thread.
+    */
+    bool loadModelFile(const std::string& filename, std::ostream& os);
+    bool loadModelFileInBackground(const std::string& filename);
+    void cancelModelLoading();
+    bool isLoadingModel() const;
+
+    bool loadSnapshot(const std::string& filename);
+    bool saveSnapshot(const std::string& filename);
+
+    /// first descendant with the given name in the preorder
+    Item* findItemByName(const std::string& name) const;
     bool saveModelFile(const std::string& filename);
     bool saveModelFileURDF(const std::string& filename);
     bool saveModelFileSDF(const std::string& filename);
+    bool saveModelFileGLB(const std::string& filename);
     
 protected:
     virtual Item* doDuplicate() const;
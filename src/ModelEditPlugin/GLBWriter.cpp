@@ -0,0 +1,597 @@
+/**
+   @file
+*/
+
+#include "GLBWriter.h"
+#include "EditableModelBase.h"
+#include "MeshExporter.h"
+#include "DoubleFormatter.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneDrawables>
+#include <boost/scoped_array.hpp>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const size_t FILE_BUFFER_SIZE = 1 << 20;
+
+const boost::uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+const boost::uint32_t GLB_VERSION = 2;
+const boost::uint32_t CHUNK_TYPE_JSON = 0x4E4F534A;
+const boost::uint32_t CHUNK_TYPE_BIN = 0x004E4942;
+
+const int COMPONENT_FLOAT = 5126;
+const int COMPONENT_UNSIGNED_INT = 5125;
+const int TARGET_ARRAY_BUFFER = 34962;
+const int TARGET_ELEMENT_ARRAY_BUFFER = 34963;
+
+// the fixed-size vectorizable Eigen types are not stored in the containers
+// because they require aligned allocators
+struct GltfNode
+{
+    string name;
+    bool hasPose;
+    double translation[3];
+    double rotation[4];
+    bool hasMatrix;
+    double matrix[16];
+    int mesh;
+    vector<int> children;
+};
+
+struct GltfBufferView
+{
+    size_t offset;
+    size_t length;
+    int target;
+};
+
+struct GltfAccessor
+{
+    int bufferView;
+    int componentType;
+    size_t count;
+    const char* type;
+    bool hasBounds;
+    float min[3];
+    float max[3];
+};
+
+struct GltfMesh
+{
+    int positions;
+    int normals;
+    int indices;
+    int material;
+};
+
+void putUInt32(std::ostream& os, boost::uint32_t value)
+{
+    // GLB is little endian regardless of the host
+    char bytes[4];
+    for(int i=0; i < 4; ++i){
+        bytes[i] = static_cast<char>((value >> (i * 8)) & 0xff);
+    }
+    os.write(bytes, 4);
+}
+
+string escapeJSON(const string& str)
+{
+    ostringstream oss;
+    for(size_t i=0; i < str.size(); ++i){
+        const char c = str[i];
+        if(c == '"' || c == '\\'){
+            oss << '\\' << c;
+        } else if(static_cast<unsigned char>(c) < 0x20){
+            char buf[8];
+            std::sprintf(buf, "\\u%04x", static_cast<int>(c));
+            oss << buf;
+        } else {
+            oss << c;
+        }
+    }
+    return oss.str();
+}
+
+}
+
+
+namespace cnoid {
+
+class GLBWriterImpl
+{
+public:
+    GLBWriter* self;
+    vector<GltfNode> nodes;
+    vector<int> rootNodes;
+    int currentNode;
+
+    // binary chunk and the views of its contents, which are looked up by their hash
+    string binary;
+    vector<GltfBufferView> bufferViews;
+    multimap<boost::uint64_t, int> bufferViewsByHash;
+
+    vector<GltfAccessor> accessors;
+    vector<GltfMesh> meshes;
+    map<pair<const SgMesh*, int>, int> meshIndices;
+    vector<vector<float> > materials;
+    map<vector<float>, int> materialIndices;
+
+    GLBWriterImpl(GLBWriter* self);
+    void writeItem(EditableModelBase* item, EditableModelBase* parentItem, int parentNode);
+    void addShapeNode(SgNode* node, const Affine3& T);
+    int findOrAddMesh(SgMesh* mesh, SgMaterial* material);
+    int findOrAddMaterial(SgMaterial* material);
+    int addBufferView(const char* data, size_t length, int target);
+    int addVertexAccessor(const vector<Vector3f>& values, bool hasBounds);
+    int addIndexAccessor(const vector<boost::uint32_t>& indices);
+    void writeJSON(std::ostream& os);
+    bool write(Item* modelItem, std::ostream& os);
+};
+
+}
+
+
+GLBWriter::GLBWriter()
+{
+    impl = new GLBWriterImpl(this);
+}
+
+
+GLBWriterImpl::GLBWriterImpl(GLBWriter* self)
+    : self(self)
+{
+    currentNode = -1;
+}
+
+
+GLBWriter::~GLBWriter()
+{
+    delete impl;
+}
+
+
+void GLBWriterImpl::writeItem(EditableModelBase* item, EditableModelBase* parentItem, int parentNode)
+{
+    int index = nodes.size();
+    nodes.push_back(GltfNode());
+    GltfNode& node = nodes.back();
+    node.name = item->name();
+    node.hasPose = true;
+    Vector3 p;
+    Quat q;
+    if(parentItem){
+        const Matrix3 Rt = parentItem->absRotation.transpose();
+        p = Rt * (item->absTranslation - parentItem->absTranslation);
+        q = Quat(Matrix3(Rt * item->absRotation));
+    } else {
+        p = item->absTranslation;
+        q = Quat(item->absRotation);
+    }
+    q.normalize();
+    for(int i=0; i < 3; ++i){
+        node.translation[i] = p[i];
+    }
+    node.rotation[0] = q.x();
+    node.rotation[1] = q.y();
+    node.rotation[2] = q.z();
+    node.rotation[3] = q.w();
+    node.hasMatrix = false;
+    node.mesh = -1;
+
+    if(parentNode >= 0){
+        nodes[parentNode].children.push_back(index);
+    } else {
+        rootNodes.push_back(index);
+    }
+
+    currentNode = index;
+    item->writeGLB(*self);
+
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        EditableModelBase* childModel = dynamic_cast<EditableModelBase*>(child);
+        if(childModel){
+            writeItem(childModel, item, index);
+        }
+    }
+}
+
+
+void GLBWriter::addShapeNode(SgNode* node)
+{
+    impl->addShapeNode(node, Affine3::Identity());
+}
+
+
+void GLBWriterImpl::addShapeNode(SgNode* node, const Affine3& T)
+{
+    if(!node || currentNode < 0){
+        return;
+    }
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        SgMesh* mesh = shape->mesh();
+        if(!mesh || !mesh->hasVertices() || mesh->vertices()->empty() || mesh->triangleVertices().empty()){
+            return;
+        }
+        GltfNode shapeNode;
+        shapeNode.hasPose = false;
+        shapeNode.hasMatrix = !T.matrix().isIdentity();
+        // column-major as the matrix of Eigen
+        std::copy(T.data(), T.data() + 16, shapeNode.matrix);
+        shapeNode.mesh = findOrAddMesh(mesh, shape->material());
+        const int parent = currentNode;
+        nodes[parent].children.push_back(nodes.size());
+        nodes.push_back(shapeNode);
+
+    } else if(SgTransform* transform = dynamic_cast<SgTransform*>(node)){
+        Affine3 T_local;
+        transform->getTransform(T_local);
+        const Affine3 T_child = T * T_local;
+        for(int i=0; i < transform->numChildren(); ++i){
+            addShapeNode(transform->child(i), T_child);
+        }
+    } else if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            addShapeNode(group->child(i), T);
+        }
+    }
+}
+
+
+int GLBWriterImpl::findOrAddMesh(SgMesh* mesh, SgMaterial* material)
+{
+    const int materialIndex = findOrAddMaterial(material);
+    const pair<const SgMesh*, int> key(mesh, materialIndex);
+    map<pair<const SgMesh*, int>, int>::iterator p = meshIndices.find(key);
+    if(p != meshIndices.end()){
+        return p->second;
+    }
+
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgIndexArray& triangles = mesh->triangleVertices();
+    const SgNormalArray* normals = mesh->hasNormals() ? mesh->normals() : 0;
+    const SgIndexArray& normalIndices = mesh->normalIndices();
+
+    vector<Vector3f> positionValues;
+    vector<Vector3f> normalValues;
+    vector<boost::uint32_t> indices;
+    indices.reserve(triangles.size());
+
+    if(normals && normalIndices.empty() && normals->size() == vertices.size()){
+        positionValues.assign(vertices.begin(), vertices.end());
+        normalValues.assign(normals->begin(), normals->end());
+        indices.assign(triangles.begin(), triangles.end());
+
+    } else if(normals && normalIndices.size() == triangles.size()){
+        // glTF has one index for all the attributes, so each pair of a vertex
+        // and a normal used by the triangles becomes a vertex
+        map<pair<int, int>, boost::uint32_t> corners;
+        for(size_t i=0; i < triangles.size(); ++i){
+            const pair<int, int> corner(triangles[i], normalIndices[i]);
+            map<pair<int, int>, boost::uint32_t>::iterator q = corners.find(corner);
+            if(q == corners.end()){
+                q = corners.insert(make_pair(corner, (boost::uint32_t)positionValues.size())).first;
+                positionValues.push_back(vertices[corner.first]);
+                normalValues.push_back((*normals)[corner.second]);
+            }
+            indices.push_back(q->second);
+        }
+    } else {
+        positionValues.assign(vertices.begin(), vertices.end());
+        indices.assign(triangles.begin(), triangles.end());
+    }
+
+    GltfMesh gltfMesh;
+    gltfMesh.positions = addVertexAccessor(positionValues, true);
+    gltfMesh.normals = normalValues.empty() ? -1 : addVertexAccessor(normalValues, false);
+    gltfMesh.indices = addIndexAccessor(indices);
+    gltfMesh.material = materialIndex;
+
+    const int index = meshes.size();
+    meshes.push_back(gltfMesh);
+    meshIndices[key] = index;
+    return index;
+}
+
+
+int GLBWriterImpl::findOrAddMaterial(SgMaterial* material)
+{
+    vector<float> key(4);
+    if(material){
+        const Vector3f& c = material->diffuseColor();
+        key[0] = c[0];
+        key[1] = c[1];
+        key[2] = c[2];
+        key[3] = 1.0f - material->transparency();
+    } else {
+        key[0] = key[1] = key[2] = 0.8f;
+        key[3] = 1.0f;
+    }
+    map<vector<float>, int>::iterator p = materialIndices.find(key);
+    if(p != materialIndices.end()){
+        return p->second;
+    }
+    const int index = materials.size();
+    materials.push_back(key);
+    materialIndices[key] = index;
+    return index;
+}
+
+
+int GLBWriterImpl::addBufferView(const char* data, size_t length, int target)
+{
+    const boost::uint64_t hash = MeshExporter::hash(data, length);
+    typedef multimap<boost::uint64_t, int>::iterator iterator;
+    pair<iterator, iterator> range = bufferViewsByHash.equal_range(hash);
+    for(iterator p = range.first; p != range.second; ++p){
+        const GltfBufferView& view = bufferViews[p->second];
+        if(view.length == length && view.target == target &&
+           std::memcmp(binary.data() + view.offset, data, length) == 0){
+            return p->second;
+        }
+    }
+
+    GltfBufferView view;
+    view.offset = binary.size();
+    view.length = length;
+    view.target = target;
+    binary.append(data, length);
+    // all the components are four bytes long
+    while(binary.size() % 4){
+        binary.push_back('\0');
+    }
+    const int index = bufferViews.size();
+    bufferViews.push_back(view);
+    bufferViewsByHash.insert(make_pair(hash, index));
+    return index;
+}
+
+
+int GLBWriterImpl::addVertexAccessor(const vector<Vector3f>& values, bool hasBounds)
+{
+    // the values are written in the byte order of the host, which is little endian
+    // on all the platforms supported by Choreonoid
+    vector<float> data(values.size() * 3);
+    GltfAccessor accessor;
+    for(int j=0; j < 3; ++j){
+        accessor.min[j] = std::numeric_limits<float>::max();
+        accessor.max[j] = -std::numeric_limits<float>::max();
+    }
+    for(size_t i=0; i < values.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            const float v = values[i][j];
+            data[i * 3 + j] = v;
+            if(v < accessor.min[j]) accessor.min[j] = v;
+            if(v > accessor.max[j]) accessor.max[j] = v;
+        }
+    }
+    accessor.bufferView = addBufferView(
+        reinterpret_cast<const char*>(&data[0]), data.size() * sizeof(float), TARGET_ARRAY_BUFFER);
+    accessor.componentType = COMPONENT_FLOAT;
+    accessor.count = values.size();
+    accessor.type = "VEC3";
+    accessor.hasBounds = hasBounds;
+
+    const int index = accessors.size();
+    accessors.push_back(accessor);
+    return index;
+}
+
+
+int GLBWriterImpl::addIndexAccessor(const vector<boost::uint32_t>& indices)
+{
+    GltfAccessor accessor;
+    accessor.bufferView = addBufferView(
+        reinterpret_cast<const char*>(&indices[0]), indices.size() * sizeof(boost::uint32_t),
+        TARGET_ELEMENT_ARRAY_BUFFER);
+    accessor.componentType = COMPONENT_UNSIGNED_INT;
+    accessor.count = indices.size();
+    accessor.type = "SCALAR";
+    accessor.hasBounds = false;
+
+    const int index = accessors.size();
+    accessors.push_back(accessor);
+    return index;
+}
+
+
+void GLBWriterImpl::writeJSON(std::ostream& os)
+{
+    os.imbue(DoubleFormatter::locale());
+
+    os << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Choreonoid ModelEditPlugin\"},";
+    os << "\"scene\":0,\"scenes\":[{\"nodes\":[";
+    for(size_t i=0; i < rootNodes.size(); ++i){
+        os << (i ? "," : "") << rootNodes[i];
+    }
+    os << "]}]";
+
+    if(!nodes.empty()){
+        os << ",\"nodes\":[";
+        for(size_t i=0; i < nodes.size(); ++i){
+            const GltfNode& node = nodes[i];
+            os << (i ? "," : "") << "{";
+            bool hasMember = false;
+            if(!node.name.empty()){
+                os << "\"name\":\"" << escapeJSON(node.name) << "\"";
+                hasMember = true;
+            }
+            if(node.hasPose){
+                const double* p = node.translation;
+                const double* q = node.rotation;
+                os << (hasMember ? "," : "")
+                   << "\"translation\":[" << p[0] << "," << p[1] << "," << p[2] << "],"
+                   << "\"rotation\":[" << q[0] << "," << q[1] << "," << q[2] << "," << q[3] << "]";
+                hasMember = true;
+            }
+            if(node.hasMatrix){
+                const double* m = node.matrix;
+                os << (hasMember ? "," : "") << "\"matrix\":[";
+                for(int j=0; j < 16; ++j){
+                    os << (j ? "," : "") << m[j];
+                }
+                os << "]";
+                hasMember = true;
+            }
+            if(node.mesh >= 0){
+                os << (hasMember ? "," : "") << "\"mesh\":" << node.mesh;
+                hasMember = true;
+            }
+            if(!node.children.empty()){
+                os << (hasMember ? "," : "") << "\"children\":[";
+                for(size_t j=0; j < node.children.size(); ++j){
+                    os << (j ? "," : "") << node.children[j];
+                }
+                os << "]";
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+
+    if(!meshes.empty()){
+        os << ",\"meshes\":[";
+        for(size_t i=0; i < meshes.size(); ++i){
+            const GltfMesh& mesh = meshes[i];
+            os << (i ? "," : "") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << mesh.positions;
+            if(mesh.normals >= 0){
+                os << ",\"NORMAL\":" << mesh.normals;
+            }
+            os << "},\"indices\":" << mesh.indices << ",\"material\":" << mesh.material << "}]}";
+        }
+        os << "]";
+
+        os << ",\"materials\":[";
+        for(size_t i=0; i < materials.size(); ++i){
+            const vector<float>& c = materials[i];
+            os << (i ? "," : "") << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":["
+               << FloatText(c[0]) << "," << FloatText(c[1]) << "," << FloatText(c[2]) << ","
+               << FloatText(c[3]) << "],"
+               << "\"metallicFactor\":0,\"roughnessFactor\":1}";
+            if(c[3] < 1.0f){
+                os << ",\"alphaMode\":\"BLEND\"";
+            }
+            os << "}";
+        }
+        os << "]";
+
+        os << ",\"accessors\":[";
+        for(size_t i=0; i < accessors.size(); ++i){
+            const GltfAccessor& a = accessors[i];
+            os << (i ? "," : "") << "{\"bufferView\":" << a.bufferView
+               << ",\"componentType\":" << a.componentType
+               << ",\"count\":" << a.count
+               << ",\"type\":\"" << a.type << "\"";
+            if(a.hasBounds){
+                os << ",\"min\":[" << FloatText(a.min[0]) << "," << FloatText(a.min[1]) << ","
+                   << FloatText(a.min[2]) << "]"
+                   << ",\"max\":[" << FloatText(a.max[0]) << "," << FloatText(a.max[1]) << ","
+                   << FloatText(a.max[2]) << "]";
+            }
+            os << "}";
+        }
+        os << "]";
+
+        os << ",\"bufferViews\":[";
+        for(size_t i=0; i < bufferViews.size(); ++i){
+            const GltfBufferView& v = bufferViews[i];
+            os << (i ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << v.offset
+               << ",\"byteLength\":" << v.length << ",\"target\":" << v.target << "}";
+        }
+        os << "]";
+
+        os << ",\"buffers\":[{\"byteLength\":" << binary.size() << "}]";
+    }
+    os << "}";
+}
+
+
+bool GLBWriter::write(Item* modelItem, std::ostream& os)
+{
+    return impl->write(modelItem, os);
+}
+
+
+bool GLBWriterImpl::write(Item* modelItem, std::ostream& os)
+{
+    // the models are z-up while glTF is y-up, so the root node rotates the
+    // model by -90 degrees about x
+    const int root = nodes.size();
+    GltfNode rootNode;
+    rootNode.name = modelItem->name();
+    rootNode.hasPose = true;
+    std::fill(rootNode.translation, rootNode.translation + 3, 0.0);
+    const Quat q(AngleAxis(-PI / 2.0, Vector3::UnitX()));
+    rootNode.rotation[0] = q.x();
+    rootNode.rotation[1] = q.y();
+    rootNode.rotation[2] = q.z();
+    rootNode.rotation[3] = q.w();
+    rootNode.hasMatrix = false;
+    rootNode.mesh = -1;
+    nodes.push_back(rootNode);
+    rootNodes.push_back(root);
+
+    for(Item* child = modelItem->childItem(); child; child = child->nextItem()){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
+        if(item){
+            writeItem(item, 0, root);
+        }
+    }
+    currentNode = -1;
+
+    ostringstream json;
+    writeJSON(json);
+    string jsonChunk = json.str();
+    while(jsonChunk.size() % 4){
+        jsonChunk.push_back(' ');
+    }
+
+    const bool hasBinary = !binary.empty();
+    boost::uint32_t totalLength = 12 + 8 + jsonChunk.size();
+    if(hasBinary){
+        totalLength += 8 + binary.size();
+    }
+
+    putUInt32(os, GLB_MAGIC);
+    putUInt32(os, GLB_VERSION);
+    putUInt32(os, totalLength);
+
+    putUInt32(os, jsonChunk.size());
+    putUInt32(os, CHUNK_TYPE_JSON);
+    os.write(jsonChunk.data(), jsonChunk.size());
+
+    if(hasBinary){
+        putUInt32(os, binary.size());
+        putUInt32(os, CHUNK_TYPE_BIN);
+        os.write(binary.data(), binary.size());
+    }
+
+    return !os.fail();
+}
+
+
+bool GLBWriter::save(Item* modelItem, const std::string& filename)
+{
+    boost::scoped_array<char> buffer(new char[FILE_BUFFER_SIZE]);
+    std::ofstream ofs;
+    ofs.rdbuf()->pubsetbuf(buffer.get(), FILE_BUFFER_SIZE);
+    ofs.open(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!ofs){
+        return false;
+    }
+    GLBWriter writer;
+    bool written = writer.write(modelItem, ofs);
+    ofs.close();
+    return written && !ofs.fail();
+}
@@ -0,0 +1,52 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_GLB_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_GLB_WRITER_H
+
+#include <cnoid/Item>
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class GLBWriterImpl;
+
+/**
+   Writes an item tree as a binary glTF 2.0 file.
+   The model is placed below a root node which converts it to the y-up
+   frame of glTF. Each item becomes a node placed at its pose relative to
+   the parent item, and the geometry added by the items is stored in one
+   binary buffer.
+   Meshes shared by several shapes, vertex data with the same contents and
+   materials with the same colors are stored only once.
+*/
+class CNOID_EXPORT GLBWriter
+{
+public:
+    GLBWriter();
+    ~GLBWriter();
+
+    /**
+       Adds the shapes in the scene graph of the node to the item being
+       written. The node must be expressed in the frame of the item.
+    */
+    void addShapeNode(SgNode* node);
+
+    bool write(Item* modelItem, std::ostream& os);
+
+    static bool save(Item* modelItem, const std::string& filename);
+
+private:
+    GLBWriter(const GLBWriter&);
+    GLBWriter& operator=(const GLBWriter&);
+
+    GLBWriterImpl* impl;
+};
+
+}
+
+#endif
@@ -3,17 +3,27 @@
 */
 
 #include "JointItem.h"
+#include "SharedShapes.h"
+#include "SelectionTracker.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
-#include <cnoid/ItemTreeView>
 #include <cnoid/ItemManager>
 #include <cnoid/VRMLBody>
 #include <cnoid/SceneBody>
 #include "ModelEditDragger.h"
-#include <cnoid/MeshGenerator>
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include "DoubleFormatter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include <cnoid/ConnectionSet>
 #include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 #include "gettext.h"
 
 using namespace std;
@@ -21,12 +31,21 @@ using namespace cnoid;
 
 namespace {
 
-const char* axisNames[3] = { "x", "y", "z" };
-
 const bool TRACE_FUNCTIONS = false;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
 
+// the limits of a link are the maximum doubles when the model does not set them
+inline bool isUnlimited(double lower, double upper)
+{
+    const double max = std::numeric_limits<double>::max();
+    return lower <= -max && upper >= max;
+}
+
+// URDF requires an effort limit, which the models do not have, so a large
+// finite value is written instead
+const double URDF_EFFORT_LIMIT = 1.0e6;
+
 }
 
 
@@ -53,14 +72,14 @@ public:
 
     SceneLinkPtr sceneLink;
     SgScaleTransformPtr defaultAxesScale;
-    SgMaterialPtr axisMaterials[3];
-    double axisCylinderNormalizedRadius;
     SgPosTransformPtr axisShape;
 
-    Vector3 prevDragTranslation;
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    enum UpdateFlag { POSE_CHANGED = 1, AXIS_CHANGED = 2 };
+    int updateFlags;
+
+    ModelEditDraggerPtr positionDragger;
+    Affine3 draggerPosition;
+    ConnectionSet draggerConnections;
 
     JointItemImpl(JointItem* self);
     JointItemImpl(JointItem* self, Link* link);
@@ -68,22 +87,27 @@ public:
     ~JointItemImpl();
     
     void init();
-    void onSelectionChanged();
+    void onSelectionChanged(bool on);
     void attachPositionDragger();
+    void detachPositionDragger();
     void onDraggerStarted();
     void onDraggerDragged();
-    void onDraggerDraggedRecur(Item *parent, Vector3 dragdiff);
     void onUpdated();
+    void updateAxisShape();
     void onPositionChanged();
     double radius() const;
     void setRadius(double val);
-    VRMLNodePtr toVRML();
-    string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
+    bool setJointType(int index);
     bool setJointAxis(const std::string& value);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 };
 
 }
@@ -101,6 +125,18 @@ void JointItem::initializeClass(ExtensionManager* ext)
 }
 
 
+JointItem* JointItem::findParentJoint(Item* item)
+{
+    for (Item* parent = item->parentItem(); parent; parent = parent->parentItem()) {
+        JointItem* joint = dynamic_cast<JointItem*>(parent);
+        if (joint) {
+            return joint;
+        }
+    }
+    return 0;
+}
+
+
 JointItem::JointItem()
 {
     impl = new JointItemImpl(this);
@@ -173,72 +209,35 @@ void JointItemImpl::init()
     if (self->name().size() == 0)
         self->setName(link->name());
 
-    axisCylinderNormalizedRadius = 0.04;
-    
     defaultAxesScale = new SgScaleTransform;
-    
-    for(int i=0; i < 3; ++i){
-        SgMaterial* material = new SgMaterial;
-        Vector3f color(0.2f, 0.2f, 0.2f);
-        color[i] = 1.0f;
-        material->setDiffuseColor(Vector3f::Zero());
-        material->setEmissiveColor(color);
-        material->setAmbientIntensity(0.0f);
-        material->setTransparency(0.6f);
-        axisMaterials[i] = material;
-    }
-
-    MeshGenerator meshGenerator;
-    SgMeshPtr mesh = meshGenerator.generateArrow(1.8, 0.08, 0.1, 2.5);
-    for(int i=0; i < 3; ++i){
-        SgShape* shape = new SgShape;
-        shape->setMesh(mesh);
-        shape->setMaterial(axisMaterials[i]);
-        
-        SgPosTransform* arrow = new SgPosTransform;
-        arrow->addChild(shape);
-        if(i == 0){
-            arrow->setRotation(AngleAxis(-PI / 2.0, Vector3::UnitZ()));
-        } else if(i == 2){
-            arrow->setRotation(AngleAxis( PI / 2.0, Vector3::UnitX()));
-        }
-        SgInvariantGroup* invariant = new SgInvariantGroup;
-        invariant->setName(axisNames[i]);
-        invariant->addChild(arrow);
-        defaultAxesScale->addChild(invariant);
-    }
+    defaultAxesScale->addChild(SharedShapes::axesGizmo());
     sceneLink->addChild(defaultAxesScale);
 
-    attachPositionDragger();
+    // the disc is shared and only the rotation of axisShape is updated
+    axisShape = new SgPosTransform;
+    axisShape->addChild(SharedShapes::jointAxisDisc());
+    updateFlags = POSE_CHANGED | AXIS_CHANGED;
 
     setRadius(0.15);
 
     self->sigUpdated().connect(boost::bind(&JointItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&JointItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&JointItemImpl::onSelectionChanged, this));
+    SelectionTracker::instance()->addItem(self, boost::bind(&JointItemImpl::onSelectionChanged, this, _1));
     isselected = false;
+    draggerPosition.setIdentity();
 
     onUpdated();
 }
 
 
-void JointItemImpl::onSelectionChanged()
+void JointItemImpl::onSelectionChanged(bool selected)
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
     if (isselected != selected) {
         isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
         if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
+            attachPositionDragger();
         } else {
-            positionDragger->setDraggerAlwaysHidden(true);
+            detachPositionDragger();
         }
     }
 }
@@ -253,82 +252,88 @@ double JointItemImpl::radius() const
 void JointItemImpl::setRadius(double r)
 {
     defaultAxesScale->setScale(r);
-    positionDragger->setRadius(r * 1.5);
+    if (positionDragger) {
+        positionDragger->setRadius(r * 1.5);
+    }
     sceneLink->notifyUpdate();
 }
 
 
 void JointItemImpl::attachPositionDragger()
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&JointItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&JointItemImpl::onDraggerDragged, this));
-    positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+    positionDragger = ModelEditDraggerPool::instance()->acquire();
+    draggerConnections.add(
+        positionDragger->sigDragStarted().connect(boost::bind(&JointItemImpl::onDraggerStarted, this)));
+    draggerConnections.add(
+        positionDragger->sigPositionDragged().connect(boost::bind(&JointItemImpl::onDraggerDragged, this)));
+    positionDragger->T() = draggerPosition;
+    positionDragger->setRadius(radius() * 1.5);
+    positionDragger->setDraggerAlwaysShown(true);
     sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
 }
 
 
-void JointItemImpl::onDraggerStarted()
+void JointItemImpl::detachPositionDragger()
 {
-    prevDragTranslation = positionDragger->draggedPosition().translation();
+    draggerConnections.disconnect();
+    draggerPosition = positionDragger->T();
+    sceneLink->removeChild(positionDragger);
+    sceneLink->notifyUpdate();
+    ModelEditDraggerPool::instance()->release(positionDragger);
+    positionDragger = NULL;
 }
 
 
-void JointItemImpl::onDraggerDraggedRecur(Item *parent, Vector3 dragdiff)
+void JointItemImpl::onDraggerStarted()
 {
-    for(Item* child = parent->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            item->translation += dragdiff;
-            item->notifyUpdate();
-            onDraggerDraggedRecur(child, dragdiff);
-        }
-    }
 }
 
+
 void JointItemImpl::onDraggerDragged()
 {
     self->translation = positionDragger->draggedPosition().translation();
     self->rotation = positionDragger->draggedPosition().rotation();
-    Vector3 dragdiff = self->translation - prevDragTranslation;
-    onDraggerDraggedRecur(self, dragdiff);
-    prevDragTranslation = self->translation;
-    self->notifyUpdate();
+    ModelUpdateScheduler::instance()->schedule(self);
 }
 
 void JointItemImpl::onUpdated()
 {
-    sceneLink->translation() = self->absTranslation;
-    sceneLink->rotation() = self->absRotation;
+    if (sceneLink->translation() != self->absTranslation ||
+        sceneLink->rotation() != self->absRotation) {
+        updateFlags |= POSE_CHANGED;
+    }
+    if (updateFlags & POSE_CHANGED) {
+        sceneLink->translation() = self->absTranslation;
+        sceneLink->rotation() = self->absRotation;
+    }
+    if (updateFlags & AXIS_CHANGED) {
+        updateAxisShape();
+    }
+    if (updateFlags) {
+        sceneLink->notifyUpdate();
+        updateFlags = 0;
+    }
+}
+
 
+void JointItemImpl::updateAxisShape()
+{
     // draw shape indicator for joint axis
-    if (axisShape) {
+    string jt(jointType.selectedSymbol());
+    if (jt == "free" || jt == "fixed") {
         sceneLink->removeChild(axisShape);
-        axisShape = NULL;
+        return;
     }
-    string jt(jointType.selectedSymbol());
-    if (jt != "free" && jt != "fixed") {
-        axisShape = new SgPosTransform;
-        SgShapePtr shape = new SgShape;
-        SgMaterialPtr material = new SgMaterial;
-        material->setDiffuseColor(Vector3f(1.0f, 0.0f, 0.0f));
-        material->setEmissiveColor(Vector3f::Zero());
-        material->setAmbientIntensity(0.0f);
-        material->setTransparency(0.0f);
-        MeshGenerator meshGenerator;
-        SgMeshPtr mesh = meshGenerator.generateDisc(0.15, 0.12);
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
-        axisShape->addChild(shape);
-        Vector3 axis = jointAxis.cross(Vector3::UnitZ());
-        double th = asin(axis.norm());
-        axisShape->setRotation(AngleAxis(th, axis));
-        sceneLink->addChildOnce(axisShape);
+    // turn the normal of the disc (z axis) to the joint axis
+    Vector3 axis = Vector3::UnitZ().cross(jointAxis);
+    double s = axis.norm();
+    if (s > 1.0e-9) {
+        axisShape->setRotation(AngleAxis(atan2(s, jointAxis.z()), axis / s));
+    } else {
+        axisShape->setRotation(Matrix3::Identity());
     }
-    sceneLink->notifyUpdate();
-
+    sceneLink->addChildOnce(axisShape);
 }
 
 
@@ -340,7 +345,10 @@ JointItem::~JointItem()
 
 JointItemImpl::~JointItemImpl()
 {
-    conSelectUpdate.disconnect();
+    SelectionTracker::instance()->removeItem(self);
+    if (positionDragger) {
+        detachPositionDragger();
+    }
 }
 
 
@@ -382,6 +390,12 @@ SgNode* JointItem::getScene()
 }
 
 
+SgPosTransform* JointItem::sceneTransform()
+{
+    return impl->sceneLink;
+}
+
+
 void JointItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -394,7 +408,7 @@ void JointItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     ostringstream oss;
     putProperty.decimals(4)(_("Joint ID"), jointId, changeProperty(jointId));
     putProperty(_("Joint type"), jointType,
-                boost::bind(&Selection::selectIndex, &jointType, _1));
+                boost::bind(&JointItemImpl::setJointType, this, _1));
     string jt(jointType.selectedSymbol());
     if (jt == "rotate" || jt == "slide") {
         putProperty(_("Joint axis"), str(jointAxis),
@@ -414,11 +428,22 @@ void JointItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 }
 
 
+bool JointItemImpl::setJointType(int index)
+{
+    if (jointType.selectIndex(index)) {
+        updateFlags |= AXIS_CHANGED;
+        return true;
+    }
+    return false;
+}
+
+
 bool JointItemImpl::setJointAxis(const std::string& value)
 {
     Vector3 p;
     if(toVector3(value, p)){
         jointAxis = p;
+        updateFlags |= AXIS_CHANGED;
         return true;
     }
     return false;
@@ -430,98 +455,119 @@ void JointItemImpl::onPositionChanged()
     self->updatePosition();
 }
 
-VRMLNodePtr JointItem::toVRML()
-{
-    return impl->toVRML();
-}
-
-VRMLNodePtr JointItemImpl::toVRML()
-{
-    VRMLJointPtr node;
-    node = new VRMLJoint();
-    node->defName = self->name();
-    node->jointId = jointId;
-    node->jointType = jointType.selectedSymbol();
-    node->jointAxis = jointAxis;
-    node->ulimit.clear();
-    node->ulimit.push_back(ulimit);
-    node->llimit.clear();
-    node->llimit.push_back(llimit);
-    node->uvlimit.clear();
-    node->uvlimit.push_back(uvlimit);
-    node->lvlimit.clear();
-    node->lvlimit.push_back(lvlimit);
-    node->gearRatio = gearRatio;
-    node->rotorInertia = rotorInertia;
-    node->rotorResistor = rotorResistor;
-    node->torqueConst = torqueConst;
-    node->encoderPulse = encoderPulse;
-    node->translation = self->translation;
-    node->rotation = self->rotation;
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            VRMLNodePtr childnode = item->toVRML();
-            node->children.push_back(childnode);
-        }
-    }
-    return node;
+void JointItem::writeVRML(VRMLModelWriter& writer)
+{
+    impl->writeVRML(writer);
 }
 
-string JointItem::toURDF()
+void JointItemImpl::writeVRML(VRMLModelWriter& writer)
 {
-    return impl->toURDF();
+    writer.addJoint(writer.beginNode("Joint", self->name()));
+    writer.writeField("jointId", jointId);
+    writer.writeField("jointType", string(jointType.selectedSymbol()));
+    writer.writeField("jointAxis", jointAxis);
+    ostream& os = writer.out();
+    os << writer.indent() << "ulimit [ " << ulimit << " ]\n";
+    os << writer.indent() << "llimit [ " << llimit << " ]\n";
+    os << writer.indent() << "uvlimit [ " << uvlimit << " ]\n";
+    os << writer.indent() << "lvlimit [ " << lvlimit << " ]\n";
+    writer.writeField("gearRatio", gearRatio);
+    writer.writeField("rotorInertia", rotorInertia);
+    writer.writeField("rotorResistor", rotorResistor);
+    writer.writeField("torqueConst", torqueConst);
+    writer.writeField("encoderPulse", encoderPulse);
+    writer.writePose(self->translation, self->rotation);
+    writer.writeChildren(self);
+    writer.endNode();
 }
 
-string JointItemImpl::toURDF()
+void JointItem::writeURDF(URDFWriter& writer)
 {
-    ostringstream ss;
+    impl->writeURDF(writer);
+}
+
+void JointItemImpl::writeURDF(URDFWriter& writer)
+{
+    ostream& ss = writer.out();
     string jtype;
     jtype = "fixed";
     if (jointType.selectedSymbol() == "rotate") {
-        // TODO: use continuous when no limits are set
-        jtype = "revolute";
+        jtype = isUnlimited(llimit, ulimit) ? "continuous" : "revolute";
     } else if (jointType.selectedSymbol() == "slide") {
         jtype = "prismatic";
+    } else if (jointType.selectedSymbol() == "free") {
+        jtype = "floating";
     }
-    ss << "<joint name=\"" << self->name() << "\" type=\"" << jtype << "\">" << endl;
-    ss << " <axis>" << jointAxis[0] << " " << jointAxis[1] << " " << jointAxis[2] << "</axis>" << endl;
-    if (jtype == "revolute" || jtype == "prismatic") {
-        ss << " <limit>" << endl;
-        ss << "  <lower>" << llimit << "</lower>"<< endl;
-        ss << "  <upper>" << ulimit << "</upper>"<< endl;
-        ss << " </limit>" << endl;
-    }
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    bool needworld = false;
+    ss << "<joint name=\"" << self->name() << "\" type=\"" << jtype << "\">\n";
+    JointItem* parentjoint = JointItem::findParentJoint(self);
     if (parentjoint) {
-        Affine3 parent, child, relative;
-        ss << " <parent link=\"" << parentjoint->name() << "_LINK\"/>" << endl;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        Vector3 trans = relative.translation();
-        Vector3 rpy = rpyFromRot(relative.rotation());
-        ss << " <origin xyz=\"" << trans[0] << " " << trans[1] << " " << trans[2]
-           << "\" rpy=\"" << rpy[0] << " " << rpy[1] << " " << rpy[2] << "\"/>" << endl;
+        ss << " <parent link=\"" << parentjoint->name() << "_LINK\"/>\n";
     } else {
-        ss << " <parent link=\"world\"/>" << endl;
-        needworld = true;
+        ss << " <parent link=\"world\"/>\n";
     }
-    ss << " <child link=\"" << self->name() << "_LINK\"/>" << endl;
-    ss << "</joint>" << endl;
-    if (needworld) {
-        ss << "<link name=\"world\" />" << endl;
+    ss << " <child link=\"" << self->name() << "_LINK\"/>\n";
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(parentjoint, self, p, R);
+    writer.writeOrigin(" ", p, R);
+    if (jtype != "fixed" && jtype != "floating") {
+        ss << " <axis xyz=\"" << jointAxis[0] << " " << jointAxis[1] << " " << jointAxis[2] << "\"/>\n";
+        const double velocity = std::min(std::fabs(uvlimit), std::fabs(lvlimit));
+        ss << " <limit";
+        if (jtype != "continuous") {
+            ss << " lower=\"" << llimit << "\" upper=\"" << ulimit << "\"";
+        }
+        ss << " effort=\"" << URDF_EFFORT_LIMIT << "\" velocity=\"" << velocity << "\"/>\n";
+    }
+    ss << "</joint>\n";
+    if (!parentjoint) {
+        writer.writeWorldLink();
     }
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            ss << item->toURDF();
+    writer.writeChildren(self);
+}
+
+void JointItem::writeSDF(SDFWriter& writer)
+{
+    impl->writeSDF(writer);
+}
+
+void JointItemImpl::writeSDF(SDFWriter& writer)
+{
+    ostream& os = writer.out();
+    const string linkName = self->name() + "_LINK";
+    writer.beginLink(self, linkName);
+    writer.writeLinkElements(self);
+    writer.endLink();
+
+    string jtype("fixed");
+    if (jointType.selectedSymbol() == "rotate") {
+        jtype = "revolute";
+    } else if (jointType.selectedSymbol() == "slide") {
+        jtype = "prismatic";
+    }
+    JointItem* parentjoint = JointItem::findParentJoint(self);
+    // a free root joint is not connected to the world
+    if (parentjoint || jointType.selectedSymbol() != "free") {
+        os << "  <joint name=\"" << self->name() << "\" type=\"" << jtype << "\">\n";
+        if (parentjoint) {
+            os << "   <parent>" << parentjoint->name() << "_LINK</parent>\n";
+        } else {
+            os << "   <parent>world</parent>\n";
         }
+        os << "   <child>" << linkName << "</child>\n";
+        if (jtype == "revolute" || jtype == "prismatic") {
+            os << "   <axis>\n";
+            os << "    <xyz>" << jointAxis[0] << " " << jointAxis[1] << " " << jointAxis[2] << "</xyz>\n";
+            os << "    <limit>\n";
+            os << "     <lower>" << llimit << "</lower>\n";
+            os << "     <upper>" << ulimit << "</upper>\n";
+            os << "    </limit>\n";
+            os << "   </axis>\n";
+        }
+        os << "  </joint>\n";
     }
-    return ss.str();
+
+    writer.writeJoints(self);
 }
 
 bool JointItem::store(Archive& archive)
@@ -532,10 +578,8 @@ bool JointItem::store(Archive& archive)
 
 bool JointItemImpl::store(Archive& archive)
 {
-    archive.setDoubleFormat("% .6f");
-
-    write(archive, "position", self->translation);
-    write(archive, "attitude", Matrix3(self->rotation));
+    writeExactly(archive, "position", self->translation);
+    writeExactly(archive, "attitude", Matrix3(self->rotation));
 
     return true;
 }
@@ -560,3 +604,56 @@ bool JointItemImpl::restore(const Archive& archive)
 
     return true;
 }
+
+
+bool JointItem::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    return impl->storeState(record, writer);
+}
+
+
+bool JointItemImpl::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    record.type = ModelSnapshotRecord::JOINT;
+    record.strings[0] = writer.addString(jointType.selectedSymbol());
+    record.intParams[0] = jointId;
+    for (int i=0; i < 3; i++) {
+        record.params[i] = jointAxis[i];
+    }
+    record.params[3] = ulimit;
+    record.params[4] = llimit;
+    record.params[5] = uvlimit;
+    record.params[6] = lvlimit;
+    record.params[7] = gearRatio;
+    record.params[8] = rotorInertia;
+    record.params[9] = rotorResistor;
+    record.params[10] = torqueConst;
+    record.params[11] = encoderPulse;
+    record.params[12] = radius();
+    return true;
+}
+
+
+void JointItem::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    impl->restoreState(record, reader);
+}
+
+
+void JointItemImpl::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    jointType.select(reader.string(record.strings[0]));
+    jointId = record.intParams[0];
+    jointAxis << record.params[0], record.params[1], record.params[2];
+    ulimit = record.params[3];
+    llimit = record.params[4];
+    uvlimit = record.params[5];
+    lvlimit = record.params[6];
+    gearRatio = record.params[7];
+    rotorInertia = record.params[8];
+    rotorResistor = record.params[9];
+    torqueConst = record.params[10];
+    encoderPulse = record.params[11];
+    setRadius(record.params[12]);
+    updateFlags |= AXIS_CHANGED;
+}
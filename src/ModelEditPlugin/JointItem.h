@@ -22,18 +22,29 @@ class CNOID_EXPORT JointItem : public SceneProvider, public EditableModelBase
 {
 public:
     static void initializeClass(ExtensionManager* ext);
+
+    /**
+       Returns the nearest joint item among the ancestors of the item, or null
+       when the item is not below any joint. The URDF and SDF writers attach
+       the elements of the item to the link of this joint.
+    */
+    static JointItem* findParentJoint(Item* item);
         
     JointItem();
     JointItem(const JointItem& org);
     JointItem(Link* link);
     virtual ~JointItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     
     Link* link() const;
     
     virtual SgNode* getScene();
+    virtual SgPosTransform* sceneTransform();
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 
 protected:
     virtual Item* doDuplicate() const;
@@ -3,21 +3,29 @@
 */
 
 #include "LinkItem.h"
+#include "SelectionTracker.h"
 #include "JointItem.h"
+#include "MeshCache.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
 #include <cnoid/ItemManager>
-#include <cnoid/ItemTreeView>
 #include <cnoid/SceneBody>
 #include <cnoid/VRMLBody>
 #include <cnoid/VRMLWriter>
 #include <cnoid/MeshGenerator>
 #include "ModelEditDragger.h"
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include "DoubleFormatter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include "GLBWriter.h"
+#include <cnoid/ConnectionSet>
 #include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
 #include <iostream>
 #include <sstream>
-#include <assimp/Importer.hpp>
-#include <assimp/Exporter.hpp>
 #include "gettext.h"
 
 using namespace std;
@@ -30,6 +38,55 @@ const bool TRACE_FUNCTIONS = false;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
 
+void collectInlineUrls(VRMLNode* vnode, vector<string>& urls)
+{
+    VRMLInline* inlineNode = dynamic_cast<VRMLInline*>(vnode);
+    if (inlineNode) {
+        urls.insert(urls.end(), inlineNode->urls.begin(), inlineNode->urls.end());
+        return;
+    }
+    VRMLProtoInstance* proto = dynamic_cast<VRMLProtoInstance*>(vnode);
+    if (proto) {
+        // sensors and the other prototypes have no children field
+        if (proto->fields.count("children")) {
+            MFNode* children = get<MFNode>(&proto->fields["children"]);
+            for (size_t i=0; children && i < children->size(); i++) {
+                collectInlineUrls((*children)[i].get(), urls);
+            }
+        }
+        return;
+    }
+    VRMLGroup* group = dynamic_cast<VRMLGroup*>(vnode);
+    if (group) {
+        for (int i=0; i < group->countChildren(); i++) {
+            collectInlineUrls(group->getChild(i), urls);
+        }
+    }
+}
+
+/**
+   The size and the modification time of the inlined files, which are
+   referred only by their urls in the serialized geometry
+*/
+string inlineFileStamp(const vector<string>& urls)
+{
+    std::ostringstream stamp;
+    for (size_t i=0; i < urls.size(); i++) {
+        boost::system::error_code ec;
+        filesystem::path path(urls[i]);
+        boost::uintmax_t size = filesystem::file_size(path, ec);
+        if (ec) {
+            size = 0;
+        }
+        std::time_t mtime = filesystem::last_write_time(path, ec);
+        if (ec) {
+            mtime = 0;
+        }
+        stamp << urls[i] << ' ' << size << ' ' << mtime << '\n';
+    }
+    return stamp.str();
+}
+
 }
 
 
@@ -52,9 +109,15 @@ public:
     bool visualizeMass;
 
     Vector3 dragStartTranslation;
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    ModelEditDraggerPtr positionDragger;
+    Affine3 draggerPosition;
+    ConnectionSet draggerConnections;
+
+    // geometry of originalNode written for the mesh export
+    VRMLNodePtr meshSourceNode;
+    string meshSource;
+    vector<string> meshSourceUrls;
+    boost::uint64_t meshSourceHash;
 
     LinkItemImpl(LinkItem* self);
     LinkItemImpl(LinkItem* self, Link* link);
@@ -64,18 +127,24 @@ public:
         
     void init();
     void attachPositionDragger();
+    void detachPositionDragger();
     void onDraggerStarted();
     void onDraggerDragged();
     void onUpdated();
     void onPositionChanged();
-    void onSelectionChanged();
+    void onSelectionChanged(bool on);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool setCenterOfMass(const std::string& v);
     bool setInertia(const std::string& v);
-    VRMLNodePtr toVRML();
-    string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    string addMesh(MeshExporter& exporter);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
+    void writeGLB(GLBWriter& writer);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 };
 
 }
@@ -172,17 +241,17 @@ void LinkItemImpl::init()
     sceneLink = new SceneLink(link);
     massShape = NULL;
     visualizeMass = false;
+    meshSourceHash = 0;
 
     if(self->name().size() == 0){
         self->setName(link->name() + "_LINK");
     }
 
-    attachPositionDragger();
-
     self->sigUpdated().connect(boost::bind(&LinkItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&LinkItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&LinkItemImpl::onSelectionChanged, this));
+    SelectionTracker::instance()->addItem(self, boost::bind(&LinkItemImpl::onSelectionChanged, this, _1));
     isselected = false;
+    draggerPosition.setIdentity();
 
     onUpdated();
 }
@@ -190,38 +259,43 @@ void LinkItemImpl::init()
 
 void LinkItemImpl::attachPositionDragger()
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&LinkItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&LinkItemImpl::onDraggerDragged, this));
+    positionDragger = ModelEditDraggerPool::instance()->acquire();
+    draggerConnections.add(
+        positionDragger->sigDragStarted().connect(boost::bind(&LinkItemImpl::onDraggerStarted, this)));
+    draggerConnections.add(
+        positionDragger->sigPositionDragged().connect(boost::bind(&LinkItemImpl::onDraggerDragged, this)));
+    positionDragger->T() = draggerPosition;
     BoundingBox bb = sceneLink->untransformedBoundingBox();
     if (bb.empty()) {
         positionDragger->setRadius(0.1);
     } else {
-        positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+        positionDragger->adjustSize(bb);
     }
+    positionDragger->setDraggerAlwaysShown(true);
     sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
 }
 
 
-void LinkItemImpl::onSelectionChanged()
+void LinkItemImpl::detachPositionDragger()
+{
+    draggerConnections.disconnect();
+    draggerPosition = positionDragger->T();
+    sceneLink->removeChild(positionDragger);
+    sceneLink->notifyUpdate();
+    ModelEditDraggerPool::instance()->release(positionDragger);
+    positionDragger = NULL;
+}
+
+
+void LinkItemImpl::onSelectionChanged(bool selected)
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
     if (isselected != selected) {
         isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
         if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
+            attachPositionDragger();
         } else {
-            positionDragger->setDraggerAlwaysHidden(true);
+            detachPositionDragger();
         }
     }
 }
@@ -237,7 +311,7 @@ void LinkItemImpl::onDraggerDragged()
 {
     self->translation = positionDragger->draggedPosition().translation();
     self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    ModelUpdateScheduler::instance()->schedule(self);
 }
 
 void LinkItemImpl::onUpdated()
@@ -298,7 +372,10 @@ LinkItem::~LinkItem()
 
 LinkItemImpl::~LinkItemImpl()
 {
-    conSelectUpdate.disconnect();
+    SelectionTracker::instance()->removeItem(self);
+    if (positionDragger) {
+        detachPositionDragger();
+    }
 }
 
 
@@ -313,94 +390,190 @@ void LinkItemImpl::onPositionChanged()
 }
 
 
-VRMLNodePtr LinkItem::toVRML()
+void LinkItem::writeVRML(VRMLModelWriter& writer)
 {
-    return impl->toVRML();
+    impl->writeVRML(writer);
 }
 
-VRMLNodePtr LinkItemImpl::toVRML()
+void LinkItemImpl::writeVRML(VRMLModelWriter& writer)
 {
-    VRMLSegmentPtr node;
-    node = new VRMLSegment();
-    node->mass = mass;
-    node->centerOfMass = centerOfMass;
-    MFFloat v(momentsOfInertia.data(), momentsOfInertia.data() + 9);
-    node->momentsOfInertia = v;
-    node->defName = self->name();
+    writer.addSegment(writer.beginNode("Segment", self->name()));
+    writer.writeField("mass", mass);
+    writer.writeField("centerOfMass", centerOfMass);
+    ostream& os = writer.out();
+    os << writer.indent() << "momentsOfInertia [";
+    for (int i=0; i < 9; i++) {
+        os << " " << momentsOfInertia.data()[i];
+    }
+    os << " ]\n";
+    writer.beginField("children");
+    // the nodes of the original model are written directly instead of being copied
     if (self->originalNode) {
         VRMLProtoInstancePtr original = dynamic_pointer_cast<VRMLProtoInstance>(self->originalNode);
         if (original) {
-            node->children = get<MFNode>(original->fields["children"]);
-        }
-    }
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item){
-            node->children.push_back(item->toVRML());
+            MFNode& children = get<MFNode>(original->fields["children"]);
+            for (size_t i=0; i < children.size(); i++) {
+                writer.writeNode(children[i]);
+            }
         }
     }
-    return node;
+    writer.writeChildItems(self);
+    writer.endField();
+    writer.endNode();
 }
 
 
-string LinkItem::toURDF()
+void LinkItem::writeURDF(URDFWriter& writer)
 {
-    return impl->toURDF();
+    impl->writeURDF(writer);
 }
 
-string LinkItemImpl::toURDF()
+/**
+   Adds the geometry of the original node to the exporter and returns the
+   name of the mesh files, or an empty string if the link has no geometry.
+   The geometry is serialized again only when the original node is replaced,
+   but the inlined files are checked on every export.
+*/
+string LinkItemImpl::addMesh(MeshExporter& exporter)
 {
-    ostringstream ss;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    Affine3 relative;
-    if (parentjoint) {
-        string meshfname = "";
-        Assimp::Importer* im;
+    if (meshSourceNode != self->originalNode) {
+        meshSourceNode = self->originalNode;
+        meshSourceUrls.clear();
+        // only the geometry is written so that the links sharing the same
+        // shapes share the exported mesh files
         std::stringstream vrml;
         if (self->originalNode) {
             VRMLProtoInstancePtr original = dynamic_pointer_cast<VRMLProtoInstance>(self->originalNode);
             if (original) {
-                VRMLWriter* writer = new VRMLWriter(vrml);
-                writer->setOutFileName("temp");
-                writer->writeNode(original);
+                VRMLWriter vrmlWriter(vrml);
+                vrmlWriter.setOutFileName("temp");
+                MFNode& children = get<MFNode>(original->fields["children"]);
+                for (size_t i=0; i < children.size(); i++) {
+                    vrmlWriter.writeNode(children[i]);
+                    collectInlineUrls(children[i].get(), meshSourceUrls);
+                }
             }
         }
-        const aiScene* ashape;
-        ashape = im->ReadFileFromMemory(vrml.str().c_str(), vrml.str().length(), 0);
-        Assimp::Exporter* ex;
-        ex = new Assimp::Exporter();
-        ex->Export(ashape, "collada", meshfname + ".dae");
-        ex->Export(ashape, "stl", meshfname + ".stl");
-        Affine3 parent, child;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        ss << "<link name=\"" << parentjoint->name() << "_LINK\">" << endl;
-        ss << " <inertial>" << endl;
-        ss << "  <mass value=\"" << mass << "\"/>" << endl;
-        ss << "  <origin xyz=\"" << centerOfMass[0] << " " << centerOfMass[1] << " " << centerOfMass[1] << "\" rpy=\"0 0 0\"/>" << endl;
-        ss << "  <inertia ixx=\"" << momentsOfInertia(0, 0)
-           << "\" ixy=\"" << momentsOfInertia(0, 1)
-           << "\" ixz=\"" << momentsOfInertia(0, 2)
-           << "\" iyy=\"" << momentsOfInertia(1, 1)
-           << "\" iyz=\"" << momentsOfInertia(1, 2)
-           << "\" izz=\"" << momentsOfInertia(2, 2) << "\" />" << endl;
-        ss << " </inertial>" << endl;
-        ss << " <visual>" << endl;
-        ss << "  <geometry>" << endl;
-        ss << "   <mesh filename=\"" << meshfname << ".dae\" />" << endl;
-        ss << "  </geometry>" << endl;
-        ss << " </visual>" << endl;
-        ss << " <collision>" << endl;
-        ss << "  <geometry>" << endl;
-        ss << "   <mesh filename=\"" << meshfname << ".stl\" />" << endl;
-        ss << "  </geometry>" << endl;
-        ss << " </collision>" << endl;
-        ss << "</link>" << endl;
+        meshSource = vrml.str();
+        meshSourceHash = MeshExporter::hash(meshSource);
+    }
+    if (meshSource.empty()) {
+        return string();
+    }
+    if (meshSourceUrls.empty()) {
+        return exporter.addMesh(meshSource, meshSourceHash);
+    }
+    return exporter.addMesh(meshSource, MeshExporter::hash(meshSource + inlineFileStamp(meshSourceUrls)));
+}
+
+
+void LinkItemImpl::writeURDF(URDFWriter& writer)
+{
+    ostream& ss = writer.out();
+    JointItem* parentjoint = JointItem::findParentJoint(self);
+    string linkName;
+    if (!parentjoint) {
+        // a link item which is not below any joint is fixed to the world
+        linkName = self->name();
+        writer.writeShapeJoint(self, linkName);
+    } else if (parentjoint == self->parentItem()) {
+        linkName = parentjoint->name() + "_LINK";
+    } else {
+        // only the link item right below a joint describes the link of the
+        // joint, e.g. the collision link items below it are not written
+        return;
+    }
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(parentjoint, self, p, R);
+    string meshfname = addMesh(writer.meshExporter());
+    ss << "<link name=\"" << linkName << "\">\n";
+    ss << " <inertial>\n";
+    ss << "  <mass value=\"" << mass << "\"/>\n";
+    writer.writeOrigin("  ", p + R * centerOfMass, R);
+    ss << "  <inertia ixx=\"" << momentsOfInertia(0, 0)
+       << "\" ixy=\"" << momentsOfInertia(0, 1)
+       << "\" ixz=\"" << momentsOfInertia(0, 2)
+       << "\" iyy=\"" << momentsOfInertia(1, 1)
+       << "\" iyz=\"" << momentsOfInertia(1, 2)
+       << "\" izz=\"" << momentsOfInertia(2, 2) << "\" />\n";
+    ss << " </inertial>\n";
+    if (!meshfname.empty()) {
+        ss << " <visual>\n";
+        writer.writeOrigin("  ", p, R);
+        ss << "  <geometry>\n";
+        ss << "   <mesh filename=\"" << meshfname << ".dae\" />\n";
+        ss << "  </geometry>\n";
+        ss << " </visual>\n";
+        ss << " <collision>\n";
+        writer.writeOrigin("  ", p, R);
+        ss << "  <geometry>\n";
+        ss << "   <mesh filename=\"" << meshfname << ".stl\" />\n";
+        ss << "  </geometry>\n";
+        ss << " </collision>\n";
+    }
+    ss << "</link>\n";
+}
+
+
+void LinkItem::writeSDF(SDFWriter& writer)
+{
+    impl->writeSDF(writer);
+}
+
+void LinkItemImpl::writeSDF(SDFWriter& writer)
+{
+    ostream& os = writer.out();
+    // the link items below another link item are not written as in URDF
+    JointItem* parentjoint = JointItem::findParentJoint(self);
+    if (parentjoint && parentjoint != self->parentItem()) {
+        return;
+    }
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(self, p, R);
+    os << "   <inertial>\n";
+    writer.writePose("    ", p + R * centerOfMass, R);
+    os << "    <mass>" << mass << "</mass>\n";
+    os << "    <inertia>\n";
+    os << "     <ixx>" << momentsOfInertia(0, 0) << "</ixx>\n";
+    os << "     <ixy>" << momentsOfInertia(0, 1) << "</ixy>\n";
+    os << "     <ixz>" << momentsOfInertia(0, 2) << "</ixz>\n";
+    os << "     <iyy>" << momentsOfInertia(1, 1) << "</iyy>\n";
+    os << "     <iyz>" << momentsOfInertia(1, 2) << "</iyz>\n";
+    os << "     <izz>" << momentsOfInertia(2, 2) << "</izz>\n";
+    os << "    </inertia>\n";
+    os << "   </inertial>\n";
+
+    string meshfname = addMesh(writer.meshExporter());
+    if (!meshfname.empty()) {
+        for (int i=0; i < 2; i++) {
+            const char* element = (i == 0) ? "visual" : "collision";
+            os << "   <" << element << " name=\"" << self->name() << "_" << element << "\">\n";
+            writer.writePose("    ", p, R);
+            os << "    <geometry>\n";
+            os << "     <mesh><uri>" << meshfname << ((i == 0) ? ".dae" : ".stl") << "</uri></mesh>\n";
+            os << "    </geometry>\n";
+            os << "   </" << element << ">\n";
+        }
+    }
+}
+
+
+void LinkItem::writeGLB(GLBWriter& writer)
+{
+    impl->writeGLB(writer);
+}
+
+
+void LinkItemImpl::writeGLB(GLBWriter& writer)
+{
+    for (int i=0; i < sceneLink->numChildren(); i++) {
+        SgNode* node = sceneLink->child(i);
+        if (node != massShape && node != positionDragger) {
+            writer.addShapeNode(node);
+        }
     }
-    return ss.str();
 }
 
 
@@ -410,6 +583,12 @@ SgNode* LinkItem::getScene()
 }
 
 
+SgPosTransform* LinkItem::sceneTransform()
+{
+    return impl->sceneLink;
+}
+
+
 void LinkItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     //EditableModelBase::doPutProperties(putProperty);
@@ -463,12 +642,10 @@ bool LinkItem::store(Archive& archive)
 
 bool LinkItemImpl::store(Archive& archive)
 {
-    archive.setDoubleFormat("% .6f");
-
     archive.writeRelocatablePath("modelFile", self->filePath());
 
-    write(archive, "position", link->p());
-    write(archive, "attitude", Matrix3(link->R()));
+    writeExactly(archive, "position", link->p());
+    writeExactly(archive, "attitude", Matrix3(link->R()));
 
     return true;
 }
@@ -502,3 +679,71 @@ bool LinkItemImpl::restore(const Archive& archive)
 
     return restored;
 }
+
+
+bool LinkItem::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    return impl->storeState(record, writer);
+}
+
+
+bool LinkItemImpl::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    record.type = ModelSnapshotRecord::LINK;
+    record.params[0] = mass;
+    for (int i=0; i < 3; i++) {
+        record.params[1 + i] = centerOfMass[i];
+        for (int j=0; j < 3; j++) {
+            record.params[4 + i * 3 + j] = momentsOfInertia(i, j);
+        }
+    }
+    record.intParams[0] = visualizeMass;
+    // the model wrapped by an inline node when it is not loaded from VRML
+    if (self->originalNode) {
+        VRMLProtoInstancePtr original = dynamic_pointer_cast<VRMLProtoInstance>(self->originalNode);
+        if (original) {
+            MFNode& children = get<MFNode>(original->fields["children"]);
+            if (children.size() == 1) {
+                VRMLInline* inlineNode = dynamic_cast<VRMLInline*>(children[0].get());
+                if (inlineNode && !inlineNode->urls.empty()) {
+                    record.strings[0] = writer.addString(inlineNode->urls[0]);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+void LinkItem::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    impl->restoreState(record, reader);
+}
+
+
+void LinkItemImpl::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    mass = record.params[0];
+    for (int i=0; i < 3; i++) {
+        centerOfMass[i] = record.params[1 + i];
+        for (int j=0; j < 3; j++) {
+            momentsOfInertia(i, j) = record.params[4 + i * 3 + j];
+        }
+    }
+    visualizeMass = record.intParams[0];
+
+    string url = reader.string(record.strings[0]);
+    if (!url.empty()) {
+        VRMLProtoInstance* proto = new VRMLProtoInstance(new VRMLProto(""));
+        MFNode children;
+        VRMLInlinePtr inl = new VRMLInline();
+        inl->urls.push_back(url);
+        children.push_back(inl);
+        proto->fields["children"] = children;
+        self->originalNode = proto;
+        SgNode* node = MeshCache::instance()->find(url);
+        if (node) {
+            sceneLink->addChildOnce(node);
+        }
+    }
+}
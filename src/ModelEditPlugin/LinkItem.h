@@ -31,10 +31,15 @@ public:
     bool loadModelFile(const std::string& filename);
     
     Link* link() const;
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
+    void writeGLB(GLBWriter& writer);
 
     virtual SgNode* getScene();
+    virtual SgPosTransform* sceneTransform();
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 
 protected:
     virtual Item* doDuplicate() const;
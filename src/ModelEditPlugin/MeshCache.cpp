@@ -0,0 +1,239 @@
+/**
+   @file
+*/
+
+#include "MeshCache.h"
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/Link>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <ctime>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+struct MeshCacheEntry
+{
+    std::time_t modifiedTime;
+    boost::uintmax_t fileSize;
+    SgNodePtr node;
+};
+
+}
+
+
+namespace cnoid {
+
+class MeshCacheImpl
+{
+public:
+    // canonical path -> loaded scene
+    map<string, MeshCacheEntry> entries;
+    // path as given by the items -> canonical path
+    map<string, string> canonicalPaths;
+    int numHits;
+    int numMisses;
+    // the maps are locked while they are accessed, but not while a file is loaded
+    boost::mutex mutex;
+    // the loaders are run one at a time because BodyLoader and the scene
+    // loaders behind it are not known to be thread-safe
+    boost::mutex loadMutex;
+
+    MeshCacheImpl();
+    bool getCanonicalPath(const string& filename, string& out_path);
+    SgNode* find(const string& filename);
+    void preload(const vector<string>& filenames, int numThreads);
+    void preloadFiles(const vector<string>* filenames, size_t* nextIndex, boost::mutex* indexMutex);
+};
+
+}
+
+
+MeshCache* MeshCache::instance()
+{
+    static MeshCache cache;
+    return &cache;
+}
+
+
+MeshCache::MeshCache()
+{
+    impl = new MeshCacheImpl;
+}
+
+
+MeshCacheImpl::MeshCacheImpl()
+{
+    numHits = 0;
+    numMisses = 0;
+}
+
+
+MeshCache::~MeshCache()
+{
+    delete impl;
+}
+
+
+bool MeshCacheImpl::getCanonicalPath(const string& filename, string& out_path)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        map<string, string>::iterator p = canonicalPaths.find(filename);
+        if(p != canonicalPaths.end()){
+            out_path = p->second;
+            return true;
+        }
+    }
+    boost::system::error_code ec;
+    filesystem::path path = filesystem::canonical(filesystem::path(filename), ec);
+    if(ec){
+        return false;
+    }
+    out_path = path.string();
+    boost::mutex::scoped_lock lock(mutex);
+    canonicalPaths[filename] = out_path;
+    return true;
+}
+
+
+SgNode* MeshCache::find(const std::string& filename)
+{
+    return impl->find(filename);
+}
+
+
+SgNode* MeshCacheImpl::find(const string& filename)
+{
+    string path;
+    if(!getCanonicalPath(filename, path)){
+        return 0;
+    }
+
+    boost::system::error_code ec;
+    std::time_t modifiedTime = filesystem::last_write_time(path, ec);
+    if(ec){
+        return 0;
+    }
+    boost::uintmax_t fileSize = filesystem::file_size(path, ec);
+    if(ec){
+        return 0;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        map<string, MeshCacheEntry>::iterator p = entries.find(path);
+        if(p != entries.end()){
+            MeshCacheEntry& entry = p->second;
+            if(entry.modifiedTime == modifiedTime && entry.fileSize == fileSize){
+                ++numHits;
+                return entry.node;
+            }
+        }
+        ++numMisses;
+    }
+
+    BodyPtr body;
+    {
+        boost::mutex::scoped_lock lock(loadMutex);
+        BodyLoader bodyLoader;
+        body = bodyLoader.load(path);
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    if(!body){
+        entries.erase(path);
+        return 0;
+    }
+    MeshCacheEntry& entry = entries[path];
+    entry.modifiedTime = modifiedTime;
+    entry.fileSize = fileSize;
+    entry.node = body->rootLink()->visualShape();
+    return entry.node;
+}
+
+
+void MeshCache::preload(const std::vector<std::string>& filenames, int numThreads)
+{
+    impl->preload(filenames, numThreads);
+}
+
+
+void MeshCacheImpl::preload(const vector<string>& filenames, int numThreads)
+{
+    // the entries are keyed by the canonical paths, so the different
+    // notations of a file are loaded once
+    set<string> uniqueSet;
+    for(size_t i=0; i < filenames.size(); ++i){
+        string path;
+        if(getCanonicalPath(filenames[i], path)){
+            uniqueSet.insert(path);
+        }
+    }
+    vector<string> uniqueFilenames(uniqueSet.begin(), uniqueSet.end());
+    if(uniqueFilenames.empty()){
+        return;
+    }
+
+    if(numThreads <= 0){
+        numThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    }
+    numThreads = std::min(numThreads, (int)uniqueFilenames.size());
+
+    size_t nextIndex = 0;
+    boost::mutex indexMutex;
+    boost::thread_group threads;
+    for(int i=1; i < numThreads; ++i){
+        threads.create_thread(
+            boost::bind(&MeshCacheImpl::preloadFiles, this, &uniqueFilenames, &nextIndex, &indexMutex));
+    }
+    // the calling thread also works as one of the loaders
+    preloadFiles(&uniqueFilenames, &nextIndex, &indexMutex);
+    threads.join_all();
+}
+
+
+void MeshCacheImpl::preloadFiles(const vector<string>* filenames, size_t* nextIndex, boost::mutex* indexMutex)
+{
+    while(true){
+        size_t index;
+        {
+            boost::mutex::scoped_lock lock(*indexMutex);
+            if(*nextIndex >= filenames->size()){
+                break;
+            }
+            index = (*nextIndex)++;
+        }
+        find((*filenames)[index]);
+    }
+}
+
+
+void MeshCache::clear()
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    impl->entries.clear();
+    impl->canonicalPaths.clear();
+    impl->numHits = 0;
+    impl->numMisses = 0;
+}
+
+
+int MeshCache::numHits() const
+{
+    return impl->numHits;
+}
+
+
+int MeshCache::numMisses() const
+{
+    return impl->numMisses;
+}
@@ -0,0 +1,52 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MESH_CACHE_H
+#define CNOID_EDITMODEL_PLUGIN_MESH_CACHE_H
+
+#include <cnoid/SceneGraph>
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class MeshCacheImpl;
+
+/**
+   Process-wide cache of the scene nodes loaded from mesh files.
+   Entries are keyed by the canonical path of the file and are reloaded
+   only when the modification time or the size of the file changes.
+*/
+class CNOID_EXPORT MeshCache
+{
+public:
+    static MeshCache* instance();
+
+    SgNode* find(const std::string& filename);
+
+    /**
+       Loads the given files into the cache with a pool of threads.
+       The files are identified by their canonical paths and each file is
+       loaded only once. The threads resolve the paths and check the files
+       in parallel, but the files themselves are parsed one at a time.
+       The number of the threads is the number of the hardware threads when
+       numThreads is zero.
+    */
+    void preload(const std::vector<std::string>& filenames, int numThreads = 0);
+    void clear();
+
+    int numHits() const;
+    int numMisses() const;
+
+private:
+    MeshCache();
+    ~MeshCache();
+
+    MeshCacheImpl* impl;
+};
+
+}
+
+#endif
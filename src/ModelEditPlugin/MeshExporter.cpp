@@ -0,0 +1,398 @@
+/**
+   @file
+*/
+
+#include "MeshExporter.h"
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/Exporter.hpp>
+#include <assimp/scene.h>
+#include <map>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const char* INDEX_FILENAME = ".cnoid_mesh_export";
+
+struct MeshExportJob
+{
+    string source;
+    string name;
+    bool failed;
+};
+
+struct ExportedFileInfo
+{
+    boost::uintmax_t size;
+    std::time_t modifiedTime;
+};
+
+// the size and modification time of the dae and stl files of a mesh
+struct ExportedMeshInfo
+{
+    ExportedFileInfo files[2];
+};
+
+const char* EXTENSIONS[2] = { ".dae", ".stl" };
+
+// the temporary names are unique so that the exports of several processes
+// into the same directory do not write into the same files
+string makeTemporaryFilename(const string& filename)
+{
+    return filesystem::unique_path(filename + ".%%%%%%%%.tmp").string();
+}
+
+
+void removeFile(const string& filename)
+{
+    boost::system::error_code ec;
+    filesystem::remove(filename, ec);
+}
+
+
+bool getFileInfo(const string& filename, ExportedFileInfo& out_info)
+{
+    boost::system::error_code ec;
+    out_info.size = filesystem::file_size(filename, ec);
+    if(ec){
+        return false;
+    }
+    out_info.modifiedTime = filesystem::last_write_time(filename, ec);
+    return !ec;
+}
+
+}
+
+
+namespace cnoid {
+
+class MeshExporterImpl
+{
+public:
+    vector<MeshExportJob> jobs;
+    map<boost::uint64_t, int> jobIndices;
+    int numExported;
+    int numReused;
+    int numFailed;
+
+    MeshExporterImpl();
+    string addMesh(const string& vrmlSource, boost::uint64_t hash);
+    bool exportMeshes(const string& directory, int numThreads);
+    void readIndex(const string& filename, map<string, ExportedMeshInfo>& out_index);
+    void writeIndex(const string& filename, const map<string, ExportedMeshInfo>& index);
+    bool isExported(const string& directory, const MeshExportJob& job,
+                    const map<string, ExportedMeshInfo>& index);
+    void exportJobs(const vector<MeshExportJob*>* pending, const string* directory,
+                    size_t* nextIndex, boost::mutex* indexMutex);
+};
+
+}
+
+
+MeshExporter::MeshExporter()
+{
+    impl = new MeshExporterImpl;
+}
+
+
+MeshExporterImpl::MeshExporterImpl()
+{
+    numExported = 0;
+    numReused = 0;
+    numFailed = 0;
+}
+
+
+MeshExporter::~MeshExporter()
+{
+    delete impl;
+}
+
+
+/**
+   64-bit FNV-1a hash
+*/
+boost::uint64_t MeshExporter::hash(const std::string& data)
+{
+    return hash(data.data(), data.size());
+}
+
+
+boost::uint64_t MeshExporter::hash(const char* data, size_t size)
+{
+    boost::uint64_t h = 14695981039346656037ULL;
+    for(size_t i=0; i < size; ++i){
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+std::string MeshExporter::addMesh(const std::string& vrmlSource)
+{
+    return impl->addMesh(vrmlSource, hash(vrmlSource));
+}
+
+
+/**
+   Adds a mesh whose hash has been computed by the caller
+*/
+std::string MeshExporter::addMesh(const std::string& vrmlSource, boost::uint64_t hash)
+{
+    return impl->addMesh(vrmlSource, hash);
+}
+
+
+/**
+   The sources with the same hash are compared because the name of a mesh is
+   made from the hash. A source colliding with a different one is given the
+   next free hash value so that it does not overwrite the other mesh.
+*/
+string MeshExporterImpl::addMesh(const string& vrmlSource, boost::uint64_t h)
+{
+    while(true){
+        map<boost::uint64_t, int>::iterator p = jobIndices.find(h);
+        if(p == jobIndices.end()){
+            break;
+        }
+        const string& source = jobs[p->second].source;
+        if(source.size() == vrmlSource.size() &&
+           std::memcmp(source.data(), vrmlSource.data(), source.size()) == 0){
+            return jobs[p->second].name;
+        }
+        ++h;
+    }
+    char name[32];
+    std::sprintf(name, "mesh_%016llx", (unsigned long long)h);
+
+    MeshExportJob job;
+    job.source = vrmlSource;
+    job.name = name;
+    job.failed = false;
+    jobIndices[h] = jobs.size();
+    jobs.push_back(job);
+    return job.name;
+}
+
+
+bool MeshExporter::exportMeshes(const std::string& directory, int numThreads)
+{
+    return impl->exportMeshes(directory, numThreads);
+}
+
+
+bool MeshExporterImpl::exportMeshes(const string& directory, int numThreads)
+{
+    const string indexFile = (filesystem::path(directory) / INDEX_FILENAME).string();
+    map<string, ExportedMeshInfo> index;
+    readIndex(indexFile, index);
+
+    vector<MeshExportJob*> pending;
+    for(size_t i=0; i < jobs.size(); ++i){
+        if(isExported(directory, jobs[i], index)){
+            ++numReused;
+        } else {
+            index.erase(jobs[i].name);
+            pending.push_back(&jobs[i]);
+        }
+    }
+    if(pending.empty()){
+        return true;
+    }
+
+    if(numThreads <= 0){
+        numThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    }
+    numThreads = std::min(numThreads, (int)pending.size());
+
+    size_t nextIndex = 0;
+    boost::mutex indexMutex;
+    boost::thread_group threads;
+    for(int i=1; i < numThreads; ++i){
+        threads.create_thread(
+            boost::bind(&MeshExporterImpl::exportJobs, this, &pending, &directory, &nextIndex, &indexMutex));
+    }
+    exportJobs(&pending, &directory, &nextIndex, &indexMutex);
+    threads.join_all();
+
+    for(size_t i=0; i < pending.size(); ++i){
+        MeshExportJob* job = pending[i];
+        ExportedMeshInfo info;
+        const string base = (filesystem::path(directory) / job->name).string();
+        if(!job->failed &&
+           getFileInfo(base + EXTENSIONS[0], info.files[0]) &&
+           getFileInfo(base + EXTENSIONS[1], info.files[1])){
+            index[job->name] = info;
+            ++numExported;
+        } else {
+            job->failed = true;
+            ++numFailed;
+        }
+    }
+    writeIndex(indexFile, index);
+
+    return numFailed == 0;
+}
+
+
+/**
+   A mesh is reused only when both of its files are recorded in the index
+   and have not been modified since they were exported.
+*/
+bool MeshExporterImpl::isExported
+(const string& directory, const MeshExportJob& job, const map<string, ExportedMeshInfo>& index)
+{
+    map<string, ExportedMeshInfo>::const_iterator p = index.find(job.name);
+    if(p == index.end()){
+        return false;
+    }
+    const string base = (filesystem::path(directory) / job.name).string();
+    for(int i=0; i < 2; ++i){
+        ExportedFileInfo info;
+        if(!getFileInfo(base + EXTENSIONS[i], info)){
+            return false;
+        }
+        if(info.size != p->second.files[i].size || info.modifiedTime != p->second.files[i].modifiedTime){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void MeshExporterImpl::readIndex(const string& filename, map<string, ExportedMeshInfo>& out_index)
+{
+    ifstream ifs(filename.c_str());
+    string line;
+    while(std::getline(ifs, line)){
+        istringstream iss(line);
+        string name;
+        ExportedMeshInfo info;
+        long long modifiedTimes[2];
+        if(iss >> name >> info.files[0].size >> modifiedTimes[0] >> info.files[1].size >> modifiedTimes[1]){
+            info.files[0].modifiedTime = modifiedTimes[0];
+            info.files[1].modifiedTime = modifiedTimes[1];
+            out_index[name] = info;
+        }
+    }
+}
+
+
+/**
+   The entries of the meshes which are not used by this export are kept
+   because the directory may be shared by several models.
+*/
+void MeshExporterImpl::writeIndex(const string& filename, const map<string, ExportedMeshInfo>& index)
+{
+    const string tmpFilename = makeTemporaryFilename(filename);
+    {
+        ofstream ofs(tmpFilename.c_str());
+        for(map<string, ExportedMeshInfo>::const_iterator p = index.begin(); p != index.end(); ++p){
+            const ExportedMeshInfo& info = p->second;
+            ofs << p->first
+                << " " << info.files[0].size << " " << (long long)info.files[0].modifiedTime
+                << " " << info.files[1].size << " " << (long long)info.files[1].modifiedTime << "\n";
+        }
+        if(!ofs){
+            ofs.close();
+            removeFile(tmpFilename);
+            return;
+        }
+    }
+    boost::system::error_code ec;
+    filesystem::rename(tmpFilename, filename, ec);
+    if(ec){
+        removeFile(tmpFilename);
+    }
+}
+
+
+void MeshExporterImpl::exportJobs
+(const vector<MeshExportJob*>* pending, const string* directory, size_t* nextIndex, boost::mutex* indexMutex)
+{
+    // importers and exporters are not shared between the threads
+    Assimp::Importer importer;
+    Assimp::Exporter exporter;
+
+    while(true){
+        MeshExportJob* job;
+        {
+            boost::mutex::scoped_lock lock(*indexMutex);
+            if(*nextIndex >= pending->size()){
+                break;
+            }
+            job = (*pending)[(*nextIndex)++];
+        }
+        const aiScene* scene = importer.ReadFileFromMemory(job->source.c_str(), job->source.length(), 0);
+        if(!scene){
+            job->failed = true;
+            continue;
+        }
+        const string base = (filesystem::path(*directory) / job->name).string();
+        // the files are written under temporary names so that an interrupted
+        // export is not reused by the next save
+        const string dae = base + ".dae";
+        const string stl = base + ".stl";
+        const string daeTmp = makeTemporaryFilename(dae);
+        const string stlTmp = makeTemporaryFilename(stl);
+        bool exported =
+            exporter.Export(scene, "collada", daeTmp) == AI_SUCCESS &&
+            exporter.Export(scene, "stl", stlTmp) == AI_SUCCESS;
+        importer.FreeScene();
+        if(exported){
+            boost::system::error_code ec;
+            filesystem::rename(daeTmp, dae, ec);
+            if(!ec){
+                filesystem::rename(stlTmp, stl, ec);
+            }
+            exported = !ec;
+        }
+        if(!exported){
+            job->failed = true;
+            removeFile(daeTmp);
+            removeFile(stlTmp);
+        }
+    }
+}
+
+
+int MeshExporter::numExportedMeshes() const
+{
+    return impl->numExported;
+}
+
+
+int MeshExporter::numReusedMeshes() const
+{
+    return impl->numReused;
+}
+
+
+int MeshExporter::numFailedMeshes() const
+{
+    return impl->numFailed;
+}
+
+
+void MeshExporter::putSummary(std::ostream& os) const
+{
+    os << impl->jobs.size() << " meshes: " << impl->numExported << " exported, "
+       << impl->numReused << " reused";
+    if(impl->numFailed > 0){
+        os << ", " << impl->numFailed << " failed";
+    }
+    os << "\n";
+}
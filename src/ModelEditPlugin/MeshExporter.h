@@ -0,0 +1,59 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MESH_EXPORTER_H
+#define CNOID_EDITMODEL_PLUGIN_MESH_EXPORTER_H
+
+#include <boost/cstdint.hpp>
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class MeshExporterImpl;
+
+/**
+   Exports the meshes referred by a URDF file as collada and stl files.
+   The meshes are added as VRML sources while the document is written and
+   are named after the hash of the source, so identical geometry is exported
+   only once. The exported files are recorded in an index file in the output
+   directory, and the files written by a previous save are reused as long
+   as they have not been changed since.
+*/
+class CNOID_EXPORT MeshExporter
+{
+public:
+    MeshExporter();
+    ~MeshExporter();
+
+    /// Returns the file name of the mesh without the extension
+    std::string addMesh(const std::string& vrmlSource);
+    std::string addMesh(const std::string& vrmlSource, boost::uint64_t hash);
+
+    /**
+       Exports the added meshes into the directory with a pool of threads.
+       The number of the threads is the number of the hardware threads when
+       numThreads is zero.
+    */
+    bool exportMeshes(const std::string& directory, int numThreads = 0);
+
+    int numExportedMeshes() const;
+    int numReusedMeshes() const;
+    int numFailedMeshes() const;
+    void putSummary(std::ostream& os) const;
+
+    static boost::uint64_t hash(const std::string& data);
+    static boost::uint64_t hash(const char* data, size_t size);
+
+private:
+    MeshExporter(const MeshExporter&);
+    MeshExporter& operator=(const MeshExporter&);
+
+    MeshExporterImpl* impl;
+};
+
+}
+
+#endif
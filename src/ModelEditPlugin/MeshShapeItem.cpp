@@ -3,16 +3,24 @@
 */
 
 #include "MeshShapeItem.h"
+#include "SelectionTracker.h"
 #include "JointItem.h"
+#include "MeshCache.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
 #include <cnoid/ItemManager>
-#include <cnoid/ItemTreeView>
-#include <cnoid/BodyLoader>
 #include <cnoid/SceneBody>
 #include <cnoid/VRMLBody>
 #include <cnoid/MeshGenerator>
 #include "ModelEditDragger.h"
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include "DoubleFormatter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include "GLBWriter.h"
+#include <cnoid/ConnectionSet>
 #include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
@@ -37,14 +45,16 @@ class MeshShapeItemImpl
 public:
     MeshShapeItem* self;
     std::string path;
+    // the path from which the shape was taken from the mesh cache
+    std::string loadedPath;
     bool isselected;
 
     SgPosTransform* sceneLink;
     SgNode* shape;
 
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    ModelEditDraggerPtr positionDragger;
+    Affine3 draggerPosition;
+    ConnectionSet draggerConnections;
 
     MeshShapeItemImpl(MeshShapeItem* self);
     MeshShapeItemImpl(MeshShapeItem* self, SgNode *shape_, const std::string &url);
@@ -54,16 +64,22 @@ public:
         
     void init();
     void attachPositionDragger();
+    void detachPositionDragger();
     void onDraggerStarted();
     void onDraggerDragged();
     void onUpdated();
+    void updateShape();
+    void reloadShape();
     void onPositionChanged();
-    void onSelectionChanged();
+    void onSelectionChanged(bool on);
     void doPutProperties(PutPropertyFunction& putProperty);
-    VRMLNodePtr toVRML();
-    string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 };
 
 }
@@ -167,12 +183,11 @@ void MeshShapeItemImpl::init()
         self->setName("MeshShape");
     }
 
-    attachPositionDragger();
-
     self->sigUpdated().connect(boost::bind(&MeshShapeItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&MeshShapeItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&MeshShapeItemImpl::onSelectionChanged, this));
+    SelectionTracker::instance()->addItem(self, boost::bind(&MeshShapeItemImpl::onSelectionChanged, this, _1));
     isselected = false;
+    draggerPosition.setIdentity();
 
     onUpdated();
 }
@@ -180,38 +195,43 @@ void MeshShapeItemImpl::init()
 
 void MeshShapeItemImpl::attachPositionDragger()
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&MeshShapeItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&MeshShapeItemImpl::onDraggerDragged, this));
+    positionDragger = ModelEditDraggerPool::instance()->acquire();
+    draggerConnections.add(
+        positionDragger->sigDragStarted().connect(boost::bind(&MeshShapeItemImpl::onDraggerStarted, this)));
+    draggerConnections.add(
+        positionDragger->sigPositionDragged().connect(boost::bind(&MeshShapeItemImpl::onDraggerDragged, this)));
+    positionDragger->T() = draggerPosition;
     BoundingBox bb = sceneLink->untransformedBoundingBox();
     if (bb.empty()) {
         positionDragger->setRadius(0.1);
     } else {
-        positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+        positionDragger->adjustSize(bb);
     }
+    positionDragger->setDraggerAlwaysShown(true);
     sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
 }
 
 
-void MeshShapeItemImpl::onSelectionChanged()
+void MeshShapeItemImpl::detachPositionDragger()
+{
+    draggerConnections.disconnect();
+    draggerPosition = positionDragger->T();
+    sceneLink->removeChild(positionDragger);
+    sceneLink->notifyUpdate();
+    ModelEditDraggerPool::instance()->release(positionDragger);
+    positionDragger = NULL;
+}
+
+
+void MeshShapeItemImpl::onSelectionChanged(bool selected)
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
     if (isselected != selected) {
         isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
         if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
+            attachPositionDragger();
         } else {
-            positionDragger->setDraggerAlwaysHidden(true);
+            detachPositionDragger();
         }
     }
 }
@@ -226,7 +246,7 @@ void MeshShapeItemImpl::onDraggerDragged()
 {
     self->translation = positionDragger->draggedPosition().translation();
     self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    ModelUpdateScheduler::instance()->schedule(self);
 }
 
 MeshShapeItem::~MeshShapeItem()
@@ -237,7 +257,10 @@ MeshShapeItem::~MeshShapeItem()
 
 MeshShapeItemImpl::~MeshShapeItemImpl()
 {
-    conSelectUpdate.disconnect();
+    SelectionTracker::instance()->removeItem(self);
+    if (positionDragger) {
+        detachPositionDragger();
+    }
 }
 
 
@@ -245,80 +268,123 @@ void MeshShapeItemImpl::onUpdated()
 {
     sceneLink->translation() = self->absTranslation;
     sceneLink->rotation() = self->absRotation;
-    if (path != ""){
-        if (shape) {
-            sceneLink->removeChild(shape);
-            shape = NULL;
-        }
-        BodyLoader bodyLoader;
-        BodyPtr newBody = bodyLoader.load(path);
-        if (!newBody) return;
-        shape = newBody->rootLink()->visualShape();
+    updateShape();
+    sceneLink->notifyUpdate();
+}
+
+
+/**
+   The mesh cache is looked up only when the path has been changed, so the
+   pose updates do not touch the file system.
+*/
+void MeshShapeItemImpl::updateShape()
+{
+    if (path == "" || path == loadedPath){
+        return;
+    }
+    loadedPath = path;
+    // the cache only parses the file again when it has been modified
+    SgNode* node = MeshCache::instance()->find(path);
+    if (node == shape){
+        return;
+    }
+    if (shape) {
+        sceneLink->removeChild(shape);
+    }
+    shape = node;
+    if (shape) {
         sceneLink->addChildOnce(shape);
-        sceneLink->notifyUpdate();
     }
 }
 
 
+void MeshShapeItem::reloadShape()
+{
+    impl->reloadShape();
+}
+
+
+void MeshShapeItemImpl::reloadShape()
+{
+    loadedPath.clear();
+    updateShape();
+    sceneLink->notifyUpdate();
+}
+
+
 void MeshShapeItemImpl::onPositionChanged()
 {
 }
 
 
-VRMLNodePtr MeshShapeItem::toVRML()
+void MeshShapeItem::writeVRML(VRMLModelWriter& writer)
 {
-    return impl->toVRML();
+    impl->writeVRML(writer);
 }
 
-VRMLNodePtr MeshShapeItemImpl::toVRML()
+void MeshShapeItemImpl::writeVRML(VRMLModelWriter& writer)
 {
-    VRMLTransformPtr trans;
-    trans = new VRMLTransform();
-    trans->translation = self->translation;
-    trans->rotation = self->rotation;
-    VRMLInlinePtr inlineNode;
-    inlineNode = new VRMLInline();
-    inlineNode->urls.push_back(path);
-    trans->children.push_back(inlineNode);
-    return trans;
+    writer.beginNode("Transform");
+    writer.writePose(self->translation, self->rotation);
+    writer.beginField("children");
+    writer.writeInline(path);
+    writer.endField();
+    writer.endNode();
 }
 
 
-string MeshShapeItem::toURDF()
+void MeshShapeItem::writeURDF(URDFWriter& writer)
 {
-    return impl->toURDF();
+    impl->writeURDF(writer);
 }
 
-string MeshShapeItemImpl::toURDF()
+void MeshShapeItemImpl::writeURDF(URDFWriter& writer)
 {
-    ostringstream ss;
-    ss << "<link name=\"" << self->name() << "\">" << endl;
-    Affine3 relative;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        Affine3 parent, child;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-    } else {
-        relative.translation() = self->translation;
-        relative.linear() = self->rotation;
+    ostream& ss = writer.out();
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(JointItem::findParentJoint(self), self, p, R);
+    writer.writeShapeJoint(self, self->name());
+    ss << "<link name=\"" << self->name() << "\">\n";
+    for (int i=0; i < 2; i++) {
+        const char* element = (i == 0) ? "visual" : "collision";
+        ss << " <" << element << ">\n";
+        writer.writeOrigin("  ", p, R);
+        ss << "  <geometry>\n";
+        ss << "   <mesh filename=\"" << path << "\" />\n";
+        ss << "  </geometry>\n";
+        ss << " </" << element << ">\n";
     }
+    ss << "</link>\n";
+}
+
+
+void MeshShapeItem::writeSDF(SDFWriter& writer)
+{
+    impl->writeSDF(writer);
+}
+
+void MeshShapeItemImpl::writeSDF(SDFWriter& writer)
+{
+    ostream& os = writer.out();
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(self, p, R);
     for (int i=0; i < 2; i++) {
-        if (i == 0) {
-            ss << " <visual>" << endl;
-        } else {
-            ss << " <collision>" << endl;
-        }
-        if (i == 0) {
-            ss << " </visual>" << endl;
-        } else {
-            ss << " </collision>" << endl;
-        }
+        const char* element = (i == 0) ? "visual" : "collision";
+        os << "   <" << element << " name=\"" << self->name() << "_" << element << "\">\n";
+        writer.writePose("    ", p, R);
+        os << "    <geometry>\n";
+        os << "     <mesh><uri>" << path << "</uri></mesh>\n";
+        os << "    </geometry>\n";
+        os << "   </" << element << ">\n";
     }
-    return ss.str();
+}
+
+
+void MeshShapeItem::writeGLB(GLBWriter& writer)
+{
+    writer.addShapeNode(impl->shape);
 }
 
 
@@ -328,6 +394,12 @@ SgNode* MeshShapeItem::getScene()
 }
 
 
+SgPosTransform* MeshShapeItem::sceneTransform()
+{
+    return impl->sceneLink;
+}
+
+
 void MeshShapeItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -349,10 +421,8 @@ bool MeshShapeItem::store(Archive& archive)
 
 bool MeshShapeItemImpl::store(Archive& archive)
 {
-    archive.setDoubleFormat("% .6f");
-
-    write(archive, "position", self->translation);
-    write(archive, "attitude", Matrix3(self->rotation));
+    writeExactly(archive, "position", self->translation);
+    writeExactly(archive, "attitude", Matrix3(self->rotation));
 
     return true;
 }
@@ -377,3 +447,30 @@ bool MeshShapeItemImpl::restore(const Archive& archive)
 
     return true;
 }
+
+
+bool MeshShapeItem::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    return impl->storeState(record, writer);
+}
+
+
+bool MeshShapeItemImpl::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    record.type = ModelSnapshotRecord::MESH_SHAPE;
+    record.strings[0] = writer.addString(path);
+    return true;
+}
+
+
+void MeshShapeItem::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    impl->restoreState(record, reader);
+}
+
+
+void MeshShapeItemImpl::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    path = reader.string(record.strings[0]);
+    updateShape();
+}
@@ -29,10 +29,21 @@ public:
     MeshShapeItem(const MeshShapeItem& org);
     virtual ~MeshShapeItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
+    void writeGLB(GLBWriter& writer);
+
+    /**
+       Takes the mesh from the mesh cache again. The cache parses the file
+       again when it has been modified.
+    */
+    void reloadShape();
 
     virtual SgNode* getScene();
+    virtual SgPosTransform* sceneTransform();
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 
 protected:
     virtual Item* doDuplicate() const;
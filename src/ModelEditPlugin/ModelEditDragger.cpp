@@ -0,0 +1,40 @@
+/**
+   @file
+*/
+
+#include "ModelEditDragger.h"
+
+using namespace cnoid;
+
+
+ModelEditDraggerPool* ModelEditDraggerPool::instance()
+{
+    static ModelEditDraggerPool pool;
+    return &pool;
+}
+
+
+ModelEditDraggerPool::ModelEditDraggerPool()
+{
+    numCreated_ = 0;
+}
+
+
+ModelEditDraggerPtr ModelEditDraggerPool::acquire()
+{
+    if(pooled.empty()){
+        ++numCreated_;
+        return new ModelEditDragger;
+    }
+    ModelEditDraggerPtr dragger = pooled.back();
+    pooled.pop_back();
+    return dragger;
+}
+
+
+void ModelEditDraggerPool::release(ModelEditDragger* dragger)
+{
+    dragger->setDraggerAlwaysHidden(true);
+    dragger->T().setIdentity();
+    pooled.push_back(dragger);
+}
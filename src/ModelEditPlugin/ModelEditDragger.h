@@ -1,4 +1,3 @@
-
 /**
 */
 
@@ -7,6 +6,7 @@
 
 #include <cnoid/PositionDragger>
 #include <cnoid/SceneDrawables>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -19,6 +19,29 @@ public:
 };
 
 typedef ref_ptr<ModelEditDragger> ModelEditDraggerPtr;
+
+/**
+   Draggers are only needed by the selected items, so they are created on
+   the first selection and recycled when the items are deselected.
+*/
+class CNOID_EXPORT ModelEditDraggerPool
+{
+public:
+    static ModelEditDraggerPool* instance();
+
+    ModelEditDraggerPtr acquire();
+    void release(ModelEditDragger* dragger);
+
+    int numCreated() const { return numCreated_; }
+    int numPooled() const { return pooled.size(); }
+
+private:
+    ModelEditDraggerPool();
+
+    std::vector<ModelEditDraggerPtr> pooled;
+    int numCreated_;
+};
+
 }
 
 #endif
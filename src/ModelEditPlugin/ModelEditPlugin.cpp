@@ -4,6 +4,7 @@
 #include "MeshShapeItem.h"
 #include "JointItem.h"
 #include "SensorItem.h"
+#include "SelectionTracker.h"
 #include <cnoid/Plugin>
 
 using namespace cnoid;
@@ -16,6 +17,7 @@ public:
     
     virtual bool initialize() {
         
+        SelectionTracker::initializeClass(this);
         EditableModelItem::initializeClass(this);
         LinkItem::initializeClass(this);
         PrimitiveShapeItem::initializeClass(this);
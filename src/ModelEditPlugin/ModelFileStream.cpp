@@ -0,0 +1,516 @@
+/**
+   @file
+*/
+
+#include "ModelFileStream.h"
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <zlib.h>
+#include <fstream>
+#include <deque>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const size_t FILE_BUFFER_SIZE = 1 << 20;
+const size_t CHUNK_SIZE = 1 << 20;
+// a chunk is being filled while the others wait for or are under the compression
+const int NUM_CHUNKS = 4;
+const unsigned int GZIP_BUFFER_SIZE = 1 << 17;
+
+struct Chunk
+{
+    vector<char> data;
+    size_t size;
+
+    Chunk() : data(CHUNK_SIZE), size(0) { }
+};
+
+
+/**
+   Stream buffer which passes the filled chunks to a compression thread.
+*/
+class GzipOutputStreamBuf : public std::streambuf
+{
+public:
+    GzipOutputStreamBuf(gzFile file);
+    ~GzipOutputStreamBuf();
+
+    bool finish();
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual int sync();
+
+private:
+    gzFile file;
+    vector<Chunk*> chunks;
+    Chunk* current;
+    deque<Chunk*> filledChunks;
+    vector<Chunk*> freeChunks;
+    boost::mutex mutex;
+    boost::condition_variable filledCondition;
+    boost::condition_variable freeCondition;
+    bool isFinishing;
+    bool failed;
+    boost::thread thread;
+
+    void submitCurrentChunk();
+    void compress();
+};
+
+
+inline bool isIdChar(char c)
+{
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u > 0x20 && u != 0x7f && std::strchr("\"#',.[\\]{}", c) == 0;
+}
+
+
+bool isRelativeUrl(const string& url)
+{
+    if(url.empty() || url.find(':') != string::npos){
+        // "http://", "file:" and the drive letters
+        return false;
+    }
+    return !filesystem::path(url).has_root_directory();
+}
+
+
+/**
+   Writes the VRML text given in chunks to a stream, replacing the relative
+   urls in the strings of the url fields by the absolute paths in the base
+   directory. The comments and the other strings are copied as they are.
+   Only a url string spanning two chunks is kept until the next chunk.
+*/
+class UrlRewriter
+{
+public:
+    UrlRewriter(std::ostream& os, const filesystem::path& baseDirectory);
+
+    void write(const char* data, size_t size);
+    void finish();
+
+private:
+    enum State { NORMAL, COMMENT, STRING, URL_STRING };
+
+    std::ostream& os;
+    filesystem::path baseDirectory;
+    State state;
+    bool isEscaped;
+    // the value of a url field is a string or a list of strings
+    bool isInUrlField;
+    // length of the identifier being copied and whether it is "url" so far
+    size_t idLength;
+    bool isUrlPrefix;
+    string url;
+    string out;
+
+    void putEscaped(const string& value);
+};
+
+
+UrlRewriter::UrlRewriter(std::ostream& os, const filesystem::path& baseDirectory)
+    : os(os),
+      baseDirectory(baseDirectory),
+      state(NORMAL),
+      isEscaped(false),
+      isInUrlField(false),
+      idLength(0),
+      isUrlPrefix(false)
+{
+
+}
+
+
+void UrlRewriter::write(const char* data, size_t size)
+{
+    out.clear();
+    out.reserve(size);
+    for(size_t i=0; i < size; ++i){
+        const char c = data[i];
+        switch(state){
+        case COMMENT:
+            out.push_back(c);
+            if(c == '\n'){
+                state = NORMAL;
+            }
+            break;
+        case STRING:
+            out.push_back(c);
+            if(isEscaped){
+                isEscaped = false;
+            } else if(c == '\\'){
+                isEscaped = true;
+            } else if(c == '"'){
+                state = NORMAL;
+            }
+            break;
+        case URL_STRING:
+            if(isEscaped){
+                url.push_back(c);
+                isEscaped = false;
+            } else if(c == '\\'){
+                isEscaped = true;
+            } else if(c == '"'){
+                out.push_back('"');
+                putEscaped(isRelativeUrl(url) ? (baseDirectory / url).generic_string() : url);
+                out.push_back('"');
+                state = NORMAL;
+            } else {
+                url.push_back(c);
+            }
+            break;
+        case NORMAL:
+            if(isIdChar(c)){
+                isUrlPrefix = (idLength == 0 || isUrlPrefix) && idLength < 3 && c == "url"[idLength];
+                ++idLength;
+                out.push_back(c);
+                break;
+            }
+            if(idLength > 0){
+                isInUrlField = (isUrlPrefix && idLength == 3);
+                idLength = 0;
+            }
+            if(c == '#'){
+                out.push_back(c);
+                state = COMMENT;
+            } else if(c == '"'){
+                if(isInUrlField){
+                    url.clear();
+                    state = URL_STRING;
+                } else {
+                    out.push_back(c);
+                    state = STRING;
+                }
+            } else {
+                if(c == ']'){
+                    isInUrlField = false;
+                }
+                out.push_back(c);
+            }
+            break;
+        }
+    }
+    os.write(out.data(), out.size());
+}
+
+
+/// writes the url of an unterminated string as it is
+void UrlRewriter::finish()
+{
+    if(state == URL_STRING){
+        out.assign(1, '"');
+        putEscaped(url);
+        os.write(out.data(), out.size());
+        state = NORMAL;
+    }
+}
+
+
+void UrlRewriter::putEscaped(const string& value)
+{
+    for(size_t i=0; i < value.size(); ++i){
+        if(value[i] == '"' || value[i] == '\\'){
+            out.push_back('\\');
+        }
+        out.push_back(value[i]);
+    }
+}
+
+}
+
+
+namespace cnoid {
+
+class ModelOutputFileImpl
+{
+public:
+    boost::scoped_array<char> buffer;
+    std::ofstream ofs;
+    boost::scoped_ptr<GzipOutputStreamBuf> gzipBuf;
+    boost::scoped_ptr<std::ostream> gzipStream;
+    bool isOpen;
+
+    ModelOutputFileImpl(const std::string& filename);
+    std::ostream& stream();
+    bool close();
+};
+
+}
+
+
+GzipOutputStreamBuf::GzipOutputStreamBuf(gzFile file)
+    : file(file),
+      isFinishing(false),
+      failed(false)
+{
+    for(int i=0; i < NUM_CHUNKS; ++i){
+        chunks.push_back(new Chunk);
+    }
+    current = chunks[0];
+    freeChunks.assign(chunks.begin() + 1, chunks.end());
+    setp(&current->data[0], &current->data[0] + CHUNK_SIZE);
+
+    thread = boost::thread(boost::bind(&GzipOutputStreamBuf::compress, this));
+}
+
+
+GzipOutputStreamBuf::~GzipOutputStreamBuf()
+{
+    finish();
+    for(size_t i=0; i < chunks.size(); ++i){
+        delete chunks[i];
+    }
+}
+
+
+GzipOutputStreamBuf::int_type GzipOutputStreamBuf::overflow(int_type c)
+{
+    submitCurrentChunk();
+    if(!traits_type::eq_int_type(c, traits_type::eof())){
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+
+int GzipOutputStreamBuf::sync()
+{
+    if(pptr() > pbase()){
+        submitCurrentChunk();
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    return failed ? -1 : 0;
+}
+
+
+void GzipOutputStreamBuf::submitCurrentChunk()
+{
+    current->size = pptr() - pbase();
+
+    boost::mutex::scoped_lock lock(mutex);
+    filledChunks.push_back(current);
+    filledCondition.notify_one();
+    while(freeChunks.empty()){
+        freeCondition.wait(lock);
+    }
+    current = freeChunks.back();
+    freeChunks.pop_back();
+    lock.unlock();
+
+    setp(&current->data[0], &current->data[0] + CHUNK_SIZE);
+}
+
+
+void GzipOutputStreamBuf::compress()
+{
+    while(true){
+        Chunk* chunk;
+        bool skip;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(filledChunks.empty() && !isFinishing){
+                filledCondition.wait(lock);
+            }
+            if(filledChunks.empty()){
+                break;
+            }
+            chunk = filledChunks.front();
+            filledChunks.pop_front();
+            skip = failed;
+        }
+        bool written = skip;
+        if(!skip && chunk->size > 0){
+            written = (gzwrite(file, &chunk->data[0], chunk->size) == (int)chunk->size);
+        }
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if(!written){
+                failed = true;
+            }
+            freeChunks.push_back(chunk);
+        }
+        freeCondition.notify_one();
+    }
+}
+
+
+/**
+   Passes the rest of the data to the compression thread, waits for the
+   thread and closes the file. The stream cannot be written after this.
+*/
+bool GzipOutputStreamBuf::finish()
+{
+    if(!file){
+        return !failed;
+    }
+    if(pptr() > pbase()){
+        submitCurrentChunk();
+    }
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        isFinishing = true;
+    }
+    filledCondition.notify_one();
+    thread.join();
+    setp(0, 0);
+
+    if(gzclose(file) != Z_OK){
+        failed = true;
+    }
+    file = 0;
+    return !failed;
+}
+
+
+ModelOutputFile::ModelOutputFile(const std::string& filename)
+{
+    impl = new ModelOutputFileImpl(filename);
+}
+
+
+ModelOutputFileImpl::ModelOutputFileImpl(const std::string& filename)
+{
+    if(isGzipFilename(filename)){
+        gzFile file = gzopen(filename.c_str(), "wb");
+        isOpen = (file != 0);
+        if(isOpen){
+            gzbuffer(file, GZIP_BUFFER_SIZE);
+            gzipBuf.reset(new GzipOutputStreamBuf(file));
+            gzipStream.reset(new std::ostream(gzipBuf.get()));
+        }
+    } else {
+        // the buffer must be set before the file is opened
+        buffer.reset(new char[FILE_BUFFER_SIZE]);
+        ofs.rdbuf()->pubsetbuf(buffer.get(), FILE_BUFFER_SIZE);
+        ofs.open(filename.c_str(), std::ios::out);
+        isOpen = ofs.is_open();
+    }
+}
+
+
+ModelOutputFile::~ModelOutputFile()
+{
+    delete impl;
+}
+
+
+bool ModelOutputFile::isOpen() const
+{
+    return impl->isOpen;
+}
+
+
+std::ostream& ModelOutputFile::stream()
+{
+    return impl->stream();
+}
+
+
+std::ostream& ModelOutputFileImpl::stream()
+{
+    if(gzipStream){
+        return *gzipStream;
+    }
+    return ofs;
+}
+
+
+bool ModelOutputFile::close()
+{
+    return impl->close();
+}
+
+
+bool ModelOutputFileImpl::close()
+{
+    if(gzipStream){
+        bool finished = gzipBuf->finish();
+        return finished && !gzipStream->fail();
+    }
+    ofs.close();
+    return !ofs.fail();
+}
+
+
+DecompressedModelFile::~DecompressedModelFile()
+{
+    if(!filename_.empty()){
+        boost::system::error_code ec;
+        filesystem::remove(filesystem::path(filename_), ec);
+    }
+}
+
+
+bool DecompressedModelFile::decompress(const std::string& filename, std::ostream& messageOut)
+{
+    gzFile file = gzopen(filename.c_str(), "rb");
+    if(!file){
+        messageOut << "\"" << filename << "\" cannot be opened." << endl;
+        return false;
+    }
+    gzbuffer(file, GZIP_BUFFER_SIZE);
+
+    boost::system::error_code ec;
+    filesystem::path path(removeGzipExtension(filename));
+    filesystem::path baseDirectory = filesystem::absolute(path).parent_path();
+    filesystem::path tmpDirectory = filesystem::temp_directory_path(ec);
+    if(ec){
+        gzclose(file);
+        messageOut << "The temporary directory for \"" << filename << "\" is not available." << endl;
+        return false;
+    }
+    // the extension before ".gz" is kept for the selection of the loader
+    filesystem::path tmpPath =
+        tmpDirectory / ("cnoid-" + filesystem::unique_path("%%%%%%%%").string() + "-" + path.filename().string());
+    filename_ = tmpPath.string();
+
+    // the decompressed chunks are written as they are read
+    boost::scoped_array<char> fileBuffer(new char[FILE_BUFFER_SIZE]);
+    std::ofstream ofs;
+    ofs.rdbuf()->pubsetbuf(fileBuffer.get(), FILE_BUFFER_SIZE);
+    ofs.open(filename_.c_str(), std::ios::out | std::ios::binary);
+    UrlRewriter rewriter(ofs, baseDirectory);
+    boost::scoped_array<char> buffer(new char[CHUNK_SIZE]);
+    int size = 0;
+    while(ofs && (size = gzread(file, buffer.get(), CHUNK_SIZE)) > 0){
+        rewriter.write(buffer.get(), size);
+    }
+    gzclose(file);
+    if(size < 0){
+        messageOut << "\"" << filename << "\" cannot be decompressed." << endl;
+        return false;
+    }
+    rewriter.finish();
+    ofs.close();
+    if(ofs.fail()){
+        messageOut << "\"" << filename << "\" cannot be decompressed to \"" << filename_ << "\"." << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool cnoid::isGzipFilename(const std::string& filename)
+{
+    return filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
+
+
+std::string cnoid::removeGzipExtension(const std::string& filename)
+{
+    if(isGzipFilename(filename)){
+        return filename.substr(0, filename.size() - 3);
+    }
+    return filename;
+}
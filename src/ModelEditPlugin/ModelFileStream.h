@@ -0,0 +1,70 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_FILE_STREAM_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_FILE_STREAM_H
+
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ModelOutputFileImpl;
+
+/**
+   Output file of the model writers. When the name ends with ".gz", the data
+   written to stream() are compressed by a separate thread, so that the
+   compression of a chunk runs while the next chunk is serialized.
+*/
+class CNOID_EXPORT ModelOutputFile
+{
+public:
+    ModelOutputFile(const std::string& filename);
+    ~ModelOutputFile();
+
+    bool isOpen() const;
+    std::ostream& stream();
+
+    /// waits for the compression of the written data. false is returned on failure.
+    bool close();
+
+private:
+    ModelOutputFileImpl* impl;
+};
+
+
+/**
+   Decompressed copy of a gzip VRML file. It is written in the temporary
+   directory of the system chunk by chunk while the file is decompressed,
+   and removed when the object is destroyed.
+   The relative urls of the url fields are replaced by the absolute paths
+   in the directory of the original file, so that they refer to the same
+   files.
+*/
+class CNOID_EXPORT DecompressedModelFile
+{
+public:
+    DecompressedModelFile() { }
+    ~DecompressedModelFile();
+
+    bool decompress(const std::string& filename, std::ostream& messageOut);
+    const std::string& filename() const { return filename_; }
+
+private:
+    std::string filename_;
+
+    DecompressedModelFile(const DecompressedModelFile&);
+    DecompressedModelFile& operator=(const DecompressedModelFile&);
+};
+
+
+CNOID_EXPORT bool isGzipFilename(const std::string& filename);
+
+/// "model.wrl" for "model.wrl.gz"
+CNOID_EXPORT std::string removeGzipExtension(const std::string& filename);
+
+}
+
+#endif
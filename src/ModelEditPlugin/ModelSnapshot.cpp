@@ -0,0 +1,283 @@
+/**
+   @file
+*/
+
+#include "ModelSnapshot.h"
+#include "EditableModelBase.h"
+#include "JointItem.h"
+#include "LinkItem.h"
+#include "PrimitiveShapeItem.h"
+#include "MeshShapeItem.h"
+#include "SensorItem.h"
+#include <cnoid/ItemTreeView>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/static_assert.hpp>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+namespace interprocess = boost::interprocess;
+
+namespace {
+
+const char MAGIC[8] = { 'C', 'N', 'O', 'I', 'D', 'M', 'E', 'S' };
+const boost::uint32_t VERSION = 1;
+const boost::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct ModelSnapshotHeader
+{
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t byteOrder;
+    boost::uint32_t recordSize;
+    boost::uint32_t numRecords;
+    boost::uint32_t stringTableSize;
+    boost::uint32_t reserved;
+};
+
+// the records are read in place from the mapped file
+BOOST_STATIC_ASSERT(sizeof(ModelSnapshotHeader) == 32);
+BOOST_STATIC_ASSERT(sizeof(ModelSnapshotRecord) == 352);
+
+EditableModelBase* createItem(int type)
+{
+    switch(type){
+    case ModelSnapshotRecord::JOINT:
+        return new JointItem;
+    case ModelSnapshotRecord::LINK:
+        return new LinkItem;
+    case ModelSnapshotRecord::PRIMITIVE_SHAPE:
+        return new PrimitiveShapeItem;
+    case ModelSnapshotRecord::MESH_SHAPE:
+        return new MeshShapeItem;
+    case ModelSnapshotRecord::SENSOR:
+        return new SensorItem;
+    }
+    return 0;
+}
+
+}
+
+
+ModelSnapshotWriter::ModelSnapshotWriter()
+{
+    // offset 0 is the empty string
+    stringTable.push_back('\0');
+    stringOffsets[""] = 0;
+}
+
+
+boost::uint32_t ModelSnapshotWriter::addString(const std::string& str)
+{
+    map<std::string, boost::uint32_t>::iterator p = stringOffsets.find(str);
+    if(p != stringOffsets.end()){
+        return p->second;
+    }
+    boost::uint32_t offset = stringTable.size();
+    stringTable.append(str.c_str(), str.size() + 1);
+    stringOffsets[str] = offset;
+    return offset;
+}
+
+
+bool ModelSnapshotWriter::write(Item* modelItem, const std::string& filename, std::ostream& os)
+{
+    ItemTreeView* itemTreeView = ItemTreeView::instance();
+
+    vector<ModelSnapshotRecord> records;
+    vector<EditableModelBase*> stack;
+    vector<int> parentStack;
+    vector<EditableModelBase*> children;
+
+    for(Item* child = modelItem->lastChildItem(); child; child = child->prevItem()){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
+        if(item){
+            stack.push_back(item);
+            parentStack.push_back(-1);
+        }
+    }
+
+    while(!stack.empty()){
+        EditableModelBase* item = stack.back();
+        int parent = parentStack.back();
+        stack.pop_back();
+        parentStack.pop_back();
+
+        ModelSnapshotRecord record;
+        std::memset(&record, 0, sizeof(record));
+        if(!item->storeState(record, *this)){
+            os << "\"" << item->name() << "\" cannot be stored in the snapshot." << endl;
+            continue;
+        }
+        record.parent = parent;
+        record.name = addString(item->name());
+        if(itemTreeView && itemTreeView->isItemChecked(item)){
+            record.flags |= ModelSnapshotRecord::CHECKED;
+        }
+        for(int i=0; i < 3; ++i){
+            record.translation[i] = item->translation[i];
+        }
+        for(int i=0; i < 3; ++i){
+            for(int j=0; j < 3; ++j){
+                record.rotation[i * 3 + j] = item->rotation(i, j);
+            }
+        }
+        int index = records.size();
+        records.push_back(record);
+
+        children.clear();
+        for(Item* child = item->childItem(); child; child = child->nextItem()){
+            EditableModelBase* childModel = dynamic_cast<EditableModelBase*>(child);
+            if(childModel){
+                children.push_back(childModel);
+            }
+        }
+        for(int i = children.size() - 1; i >= 0; --i){
+            stack.push_back(children[i]);
+            parentStack.push_back(index);
+        }
+    }
+
+    // keep the size of the file a multiple of eight bytes
+    while(stringTable.size() % 8){
+        stringTable.push_back('\0');
+    }
+
+    ModelSnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.recordSize = sizeof(ModelSnapshotRecord);
+    header.numRecords = records.size();
+    header.stringTableSize = stringTable.size();
+
+    ofstream ofs(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs){
+        os << "\"" << filename << "\" cannot be opened." << endl;
+        return false;
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if(!records.empty()){
+        ofs.write(reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(ModelSnapshotRecord));
+    }
+    ofs.write(stringTable.data(), stringTable.size());
+    ofs.close();
+
+    if(!ofs){
+        os << "\"" << filename << "\" cannot be written." << endl;
+        return false;
+    }
+    return true;
+}
+
+
+ModelSnapshotReader::ModelSnapshotReader()
+    : stringTable(0),
+      stringTableSize(0)
+{
+
+}
+
+
+std::string ModelSnapshotReader::string(boost::uint32_t offset) const
+{
+    if(offset >= stringTableSize){
+        return std::string();
+    }
+    return std::string(stringTable + offset);
+}
+
+
+bool ModelSnapshotReader::read
+(const std::string& filename, Item* parentItem, std::vector<ItemPtr>& out_checkedItems, std::ostream& os)
+{
+    try {
+        interprocess::file_mapping file(filename.c_str(), interprocess::read_only);
+        interprocess::mapped_region region(file, interprocess::read_only);
+
+        const char* data = static_cast<const char*>(region.get_address());
+        const size_t size = region.get_size();
+
+        if(size < sizeof(ModelSnapshotHeader)){
+            os << "\"" << filename << "\" is not a model snapshot." << endl;
+            return false;
+        }
+        const ModelSnapshotHeader* header = reinterpret_cast<const ModelSnapshotHeader*>(data);
+        if(std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0){
+            os << "\"" << filename << "\" is not a model snapshot." << endl;
+            return false;
+        }
+        if(header->byteOrder != BYTE_ORDER_MARK){
+            os << "The byte order of \"" << filename << "\" is not supported." << endl;
+            return false;
+        }
+        if(header->version != VERSION || header->recordSize != sizeof(ModelSnapshotRecord)){
+            os << "The snapshot version " << header->version << " of \"" << filename
+               << "\" is not supported." << endl;
+            return false;
+        }
+        const size_t recordsSize = (size_t)header->numRecords * sizeof(ModelSnapshotRecord);
+        if(sizeof(ModelSnapshotHeader) + recordsSize + header->stringTableSize > size ||
+           header->stringTableSize == 0){
+            os << "\"" << filename << "\" is truncated." << endl;
+            return false;
+        }
+
+        const ModelSnapshotRecord* records =
+            reinterpret_cast<const ModelSnapshotRecord*>(data + sizeof(ModelSnapshotHeader));
+        stringTable = data + sizeof(ModelSnapshotHeader) + recordsSize;
+        stringTableSize = header->stringTableSize;
+        if(stringTable[stringTableSize - 1] != '\0'){
+            os << "\"" << filename << "\" is corrupted." << endl;
+            return false;
+        }
+
+        vector<EditableModelBase*> items(header->numRecords, (EditableModelBase*)0);
+        for(boost::uint32_t i=0; i < header->numRecords; ++i){
+            const ModelSnapshotRecord& record = records[i];
+            EditableModelBase* item = createItem(record.type);
+            if(!item){
+                os << "Unknown item type " << record.type << " in \"" << filename << "\"." << endl;
+                continue;
+            }
+            ItemPtr holder = item;
+            Item* parent = parentItem;
+            if(record.parent >= 0){
+                // the parent always precedes its children
+                if((boost::uint32_t)record.parent >= i || !items[record.parent]){
+                    continue;
+                }
+                parent = items[record.parent];
+            }
+            item->setName(string(record.name));
+            item->translation << record.translation[0], record.translation[1], record.translation[2];
+            for(int j=0; j < 3; ++j){
+                for(int k=0; k < 3; ++k){
+                    item->rotation(j, k) = record.rotation[j * 3 + k];
+                }
+            }
+            item->restoreState(record, *this);
+            item->notifyUpdate();
+            parent->addChildItem(item);
+            items[i] = item;
+            if(record.flags & ModelSnapshotRecord::CHECKED){
+                out_checkedItems.push_back(item);
+            }
+        }
+    }
+    catch(const interprocess::interprocess_exception& ex){
+        os << "\"" << filename << "\" cannot be mapped: " << ex.what() << endl;
+        stringTable = 0;
+        stringTableSize = 0;
+        return false;
+    }
+
+    // the mapping is closed here
+    stringTable = 0;
+    stringTableSize = 0;
+    return true;
+}
@@ -0,0 +1,80 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_SNAPSHOT_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_SNAPSHOT_H
+
+#include <cnoid/Item>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Fixed-size record of an item in a model snapshot file.
+   The meaning of strings, params and intParams depends on the type and is
+   defined by the storeState and restoreState functions of each item class.
+   The layout must not be changed without increasing the snapshot version.
+*/
+struct ModelSnapshotRecord
+{
+    enum Type { JOINT = 1, LINK, PRIMITIVE_SHAPE, MESH_SHAPE, SENSOR };
+    enum Flag { CHECKED = 1 };
+    enum { NUM_STRINGS = 3, NUM_PARAMS = 24, NUM_INT_PARAMS = 8 };
+
+    boost::int32_t type;
+    boost::int32_t parent;
+    boost::uint32_t name;
+    boost::uint32_t flags;
+    boost::uint32_t strings[NUM_STRINGS];
+    boost::uint32_t reserved;
+    double translation[3];
+    double rotation[9];
+    double params[NUM_PARAMS];
+    boost::int32_t intParams[NUM_INT_PARAMS];
+};
+
+
+/**
+   Writes the edited item tree of a model as a snapshot file, which consists
+   of a header, the records of the items in preorder and a string table.
+*/
+class CNOID_EXPORT ModelSnapshotWriter
+{
+public:
+    ModelSnapshotWriter();
+
+    boost::uint32_t addString(const std::string& str);
+    bool write(Item* modelItem, const std::string& filename, std::ostream& os);
+
+private:
+    std::string stringTable;
+    std::map<std::string, boost::uint32_t> stringOffsets;
+};
+
+
+/**
+   Reads a snapshot file through a memory mapping and recreates the items.
+*/
+class CNOID_EXPORT ModelSnapshotReader
+{
+public:
+    ModelSnapshotReader();
+
+    std::string string(boost::uint32_t offset) const;
+    bool read(const std::string& filename, Item* parentItem, std::vector<ItemPtr>& out_checkedItems,
+              std::ostream& os);
+
+private:
+    const char* stringTable;
+    boost::uint32_t stringTableSize;
+};
+
+}
+
+#endif
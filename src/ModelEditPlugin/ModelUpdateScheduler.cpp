@@ -0,0 +1,167 @@
+/**
+   @file
+*/
+
+#include "ModelUpdateScheduler.h"
+#include "EditableModelBase.h"
+#include "PoseTable.h"
+#include <cnoid/LazyCaller>
+#include <QElapsedTimer>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <ostream>
+#include <set>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int NUM_LATENCY_BINS = 32;
+
+}
+
+
+namespace cnoid {
+
+class ModelUpdateSchedulerImpl
+{
+public:
+    vector<EditableModelBase*> pendingItems;
+    set<EditableModelBase*> pendingItemSet;
+    vector<qint64> requestTimes;
+    vector<int> latencyHistogram;
+    LazyCaller flushLater;
+    QElapsedTimer timer;
+
+    ModelUpdateSchedulerImpl();
+    void schedule(EditableModelBase* item);
+    void cancel(EditableModelBase* item);
+    void flush();
+};
+
+}
+
+
+ModelUpdateScheduler* ModelUpdateScheduler::instance()
+{
+    static ModelUpdateScheduler scheduler;
+    return &scheduler;
+}
+
+
+ModelUpdateScheduler::ModelUpdateScheduler()
+{
+    impl = new ModelUpdateSchedulerImpl;
+}
+
+
+ModelUpdateSchedulerImpl::ModelUpdateSchedulerImpl()
+    : latencyHistogram(NUM_LATENCY_BINS, 0)
+{
+    flushLater.setFunction(boost::bind(&ModelUpdateSchedulerImpl::flush, this));
+    flushLater.setPriority(LazyCaller::PRIORITY_NORMAL);
+    timer.start();
+}
+
+
+ModelUpdateScheduler::~ModelUpdateScheduler()
+{
+    delete impl;
+}
+
+
+void ModelUpdateScheduler::schedule(EditableModelBase* item)
+{
+    impl->schedule(item);
+}
+
+
+void ModelUpdateSchedulerImpl::schedule(EditableModelBase* item)
+{
+    requestTimes.push_back(timer.nsecsElapsed());
+    if(pendingItemSet.insert(item).second){
+        pendingItems.push_back(item);
+    }
+    flushLater();
+}
+
+
+void ModelUpdateScheduler::cancel(EditableModelBase* item)
+{
+    impl->cancel(item);
+}
+
+
+void ModelUpdateSchedulerImpl::cancel(EditableModelBase* item)
+{
+    if(pendingItemSet.erase(item)){
+        pendingItems.erase(std::remove(pendingItems.begin(), pendingItems.end(), item), pendingItems.end());
+    }
+}
+
+
+void ModelUpdateScheduler::flush()
+{
+    impl->flush();
+}
+
+
+void ModelUpdateSchedulerImpl::flush()
+{
+    // the latency is recorded when the update is dispatched so that it
+    // measures the coalescing delay alone
+    const qint64 now = timer.nsecsElapsed();
+    for(size_t i=0; i < requestTimes.size(); ++i){
+        qint64 usec = (now - requestTimes[i]) / 1000;
+        int bin = 0;
+        while(usec > 1 && bin < NUM_LATENCY_BINS - 1){
+            usec >>= 1;
+            ++bin;
+        }
+        ++latencyHistogram[bin];
+    }
+    requestTimes.clear();
+
+    vector<EditableModelBase*> items;
+    items.swap(pendingItems);
+    pendingItemSet.clear();
+
+    vector<PoseTable*> tables;
+    for(size_t i=0; i < items.size(); ++i){
+        PoseTable* table = items[i]->poseTable();
+        table->markDirty(items[i]);
+        if(std::find(tables.begin(), tables.end(), table) == tables.end()){
+            tables.push_back(table);
+        }
+    }
+    for(size_t i=0; i < tables.size(); ++i){
+        tables[i]->flush();
+    }
+    for(size_t i=0; i < items.size(); ++i){
+        items[i]->notifyUpdate();
+    }
+}
+
+
+const std::vector<int>& ModelUpdateScheduler::latencyHistogram() const
+{
+    return impl->latencyHistogram;
+}
+
+
+void ModelUpdateScheduler::clearLatencyHistogram()
+{
+    std::fill(impl->latencyHistogram.begin(), impl->latencyHistogram.end(), 0);
+}
+
+
+void ModelUpdateScheduler::putLatencyHistogram(std::ostream& os) const
+{
+    const vector<int>& histogram = impl->latencyHistogram;
+    for(size_t i=0; i < histogram.size(); ++i){
+        if(histogram[i] > 0){
+            os << (1ULL << i) << "-" << (2ULL << i) << " us: " << histogram[i] << "\n";
+        }
+    }
+}
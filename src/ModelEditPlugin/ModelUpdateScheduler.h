@@ -0,0 +1,55 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_UPDATE_SCHEDULER_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_UPDATE_SCHEDULER_H
+
+#include <vector>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class EditableModelBase;
+class ModelUpdateSchedulerImpl;
+
+/**
+   Coalesces the pose updates requested by the draggers.
+   The items scheduled while the pending events are processed are updated
+   together by a LazyCaller when the event loop becomes idle, so a burst of
+   mouse events delivered in one event loop pass results in a single pose
+   propagation and scene update. The updates are coalesced per event loop
+   pass and not per rendered frame; events arriving in separate passes are
+   flushed separately even if no frame is rendered between them.
+*/
+class CNOID_EXPORT ModelUpdateScheduler
+{
+public:
+    static ModelUpdateScheduler* instance();
+
+    void schedule(EditableModelBase* item);
+    void cancel(EditableModelBase* item);
+    void flush();
+
+    /**
+       Histogram of the delay between a schedule() call and the dispatch of
+       the update which processes it, that is, the time a request waits for
+       the flush. The pose propagation and the notifications are not
+       included. Bin i counts the delays in [2^i, 2^(i+1)) microseconds;
+       delays below one microsecond are counted in bin 0.
+    */
+    const std::vector<int>& latencyHistogram() const;
+    void clearLatencyHistogram();
+    void putLatencyHistogram(std::ostream& os) const;
+
+private:
+    ModelUpdateScheduler();
+    ~ModelUpdateScheduler();
+
+    ModelUpdateSchedulerImpl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+/**
+   @file
+*/
+
+#include "PoseTable.h"
+#include "EditableModelBase.h"
+#include <cnoid/SceneGraph>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+
+PoseTable::PoseTable(EditableModelBase* root)
+{
+    vector<EditableModelBase*> stack;
+    vector<int> parentStack;
+    vector<EditableModelBase*> children;
+
+    stack.push_back(root);
+    parentStack.push_back(-1);
+
+    while(!stack.empty()){
+        EditableModelBase* item = stack.back();
+        int parent = parentStack.back();
+        stack.pop_back();
+        parentStack.pop_back();
+
+        int index = items.size();
+        items.push_back(item);
+        parents.push_back(parent);
+        subtreeEnds.push_back(index + 1);
+        absTranslations.push_back(item->absTranslation);
+        absRotations.push_back(item->absRotation);
+        dirtyFlags.push_back(0);
+        indices[item] = index;
+
+        children.clear();
+        for(Item* child = item->childItem(); child; child = child->nextItem()){
+            EditableModelBase* childModel = dynamic_cast<EditableModelBase*>(child);
+            if(childModel){
+                children.push_back(childModel);
+            }
+        }
+        // pushed in reverse order to keep the order of the siblings
+        for(int i = children.size() - 1; i >= 0; --i){
+            stack.push_back(children[i]);
+            parentStack.push_back(index);
+        }
+    }
+
+    for(int i = items.size() - 1; i > 0; --i){
+        int parent = parents[i];
+        subtreeEnds[parent] = std::max(subtreeEnds[parent], subtreeEnds[i]);
+    }
+
+    hasDirtyItems = false;
+}
+
+
+int PoseTable::indexOf(EditableModelBase* item) const
+{
+    map<EditableModelBase*, int>::const_iterator p = indices.find(item);
+    if(p != indices.end()){
+        return p->second;
+    }
+    return -1;
+}
+
+
+void PoseTable::markDirty(EditableModelBase* item)
+{
+    int index = indexOf(item);
+    if(index >= 0){
+        dirtyFlags[index] = 1;
+        hasDirtyItems = true;
+    }
+}
+
+
+void PoseTable::markChildrenDirty(EditableModelBase* item)
+{
+    int index = indexOf(item);
+    if(index >= 0){
+        for(int i = index + 1; i < subtreeEnds[index]; i = subtreeEnds[i]){
+            dirtyFlags[i] = 1;
+            hasDirtyItems = true;
+        }
+    }
+}
+
+
+/**
+   Recomputes the poses of the dirty items and all their descendants.
+   The scene transforms of the items are written directly. The scene of each
+   item is a separate root, so every written transform is notified to let
+   the renderers and the bounding boxes of its scene see the new pose.
+*/
+void PoseTable::flush()
+{
+    if(!hasDirtyItems){
+        return;
+    }
+
+    const int n = items.size();
+    int end = 0;
+
+    for(int i=0; i < n; ++i){
+        if(i >= end){
+            if(!dirtyFlags[i]){
+                continue;
+            }
+            end = subtreeEnds[i];
+        }
+        dirtyFlags[i] = 0;
+
+        EditableModelBase* item = items[i];
+        const int parent = parents[i];
+        if(parent >= 0){
+            absTranslations[i] = absRotations[parent] * item->translation + absTranslations[parent];
+            absRotations[i] = absRotations[parent] * item->rotation;
+        } else {
+            absTranslations[i] = item->translation;
+            absRotations[i] = item->rotation;
+        }
+        item->absTranslation = absTranslations[i];
+        item->absRotation = absRotations[i];
+
+        SgPosTransform* transform = item->sceneTransform();
+        if(transform){
+            transform->translation() = absTranslations[i];
+            transform->rotation() = absRotations[i];
+            transform->notifyUpdate();
+        }
+    }
+
+    hasDirtyItems = false;
+}
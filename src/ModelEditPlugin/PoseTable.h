@@ -0,0 +1,48 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_POSE_TABLE_H
+#define CNOID_EDITMODEL_PLUGIN_POSE_TABLE_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include <map>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class EditableModelBase;
+
+/**
+   Flat table of the world poses of an EditableModelBase tree.
+   The items are stored in preorder with the indices of their parents and
+   the ends of their subtrees, so that the poses of the dirty subtrees are
+   propagated by a single loop over the table.
+*/
+class CNOID_EXPORT PoseTable
+{
+public:
+    PoseTable(EditableModelBase* root);
+
+    int size() const { return items.size(); }
+    int indexOf(EditableModelBase* item) const;
+
+    void markDirty(EditableModelBase* item);
+    void markChildrenDirty(EditableModelBase* item);
+    void flush();
+
+private:
+    std::vector<EditableModelBase*> items;
+    std::vector<int> parents;
+    std::vector<int> subtreeEnds;
+    std::vector<Vector3> absTranslations;
+    std::vector<Matrix3> absRotations;
+    std::vector<char> dirtyFlags;
+    std::map<EditableModelBase*, int> indices;
+    bool hasDirtyItems;
+};
+
+}
+
+#endif
@@ -3,15 +3,24 @@
 */
 
 #include "PrimitiveShapeItem.h"
+#include "SelectionTracker.h"
+#include "SharedShapes.h"
 #include "JointItem.h"
 #include <cnoid/EigenArchive>
+#include <cnoid/EigenUtil>
 #include <cnoid/Archive>
 #include <cnoid/ItemManager>
-#include <cnoid/ItemTreeView>
 #include <cnoid/SceneBody>
 #include <cnoid/VRMLBody>
-#include <cnoid/MeshGenerator>
 #include "ModelEditDragger.h"
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include "DoubleFormatter.h"
+#include "URDFWriter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include "GLBWriter.h"
+#include <cnoid/ConnectionSet>
 #include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
@@ -43,11 +52,19 @@ public:
     bool isselected;
 
     SgPosTransform* sceneLink;
-    SgShape* shape;
+    SgShapePtr shape;
+    SgMaterialPtr material;
 
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    enum UpdateFlag {
+        POSE_CHANGED = 1,
+        GEOMETRY_CHANGED = 2,
+        COLOR_CHANGED = 4
+    };
+    int updateFlags;
+
+    ModelEditDraggerPtr positionDragger;
+    Affine3 draggerPosition;
+    ConnectionSet draggerConnections;
 
     PrimitiveShapeItemImpl(PrimitiveShapeItem* self);
     PrimitiveShapeItemImpl(PrimitiveShapeItem* self, SgShape *shape);
@@ -57,19 +74,26 @@ public:
         
     void init();
     void attachPositionDragger();
+    void detachPositionDragger();
     void onDraggerStarted();
     void onDraggerDragged();
     void onUpdated();
     void onPositionChanged();
-    void onSelectionChanged();
+    void onSelectionChanged(bool on);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool setPrimitiveType(const std::string& t);
+    bool setPrimitiveType(int index);
     bool setBoxSize(const std::string& v);
+    bool setPrimitiveRadius(double r);
+    bool setPrimitiveHeight(double h);
     bool setPrimitiveColor(const std::string& v);
-    VRMLNodePtr toVRML();
-    string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 };
 
 }
@@ -208,17 +232,26 @@ void PrimitiveShapeItemImpl::init()
             }
             break;
         }
-        SgMaterial *material = shape->material();
-        primitiveColor = material->diffuseColor();
+        primitiveColor = shape->material()->diffuseColor();
     }
-    self->setName(primitiveType.selectedSymbol());
 
-    attachPositionDragger();
+    // the shape given by the loader is only read, the item keeps its own
+    shape = new SgShape;
+    material = new SgMaterial;
+    material->setEmissiveColor(Vector3f::Zero());
+    material->setAmbientIntensity(0.0f);
+    material->setTransparency(0.0f);
+    shape->setMaterial(material);
+    sceneLink->addChild(shape);
+    updateFlags = POSE_CHANGED | GEOMETRY_CHANGED | COLOR_CHANGED;
+
+    self->setName(primitiveType.selectedSymbol());
 
     self->sigUpdated().connect(boost::bind(&PrimitiveShapeItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&PrimitiveShapeItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&PrimitiveShapeItemImpl::onSelectionChanged, this));
+    SelectionTracker::instance()->addItem(self, boost::bind(&PrimitiveShapeItemImpl::onSelectionChanged, this, _1));
     isselected = false;
+    draggerPosition.setIdentity();
 
     onUpdated();
 }
@@ -226,38 +259,43 @@ void PrimitiveShapeItemImpl::init()
 
 void PrimitiveShapeItemImpl::attachPositionDragger()
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerDragged, this));
+    positionDragger = ModelEditDraggerPool::instance()->acquire();
+    draggerConnections.add(
+        positionDragger->sigDragStarted().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerStarted, this)));
+    draggerConnections.add(
+        positionDragger->sigPositionDragged().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerDragged, this)));
+    positionDragger->T() = draggerPosition;
     BoundingBox bb = sceneLink->untransformedBoundingBox();
     if (bb.empty()) {
         positionDragger->setRadius(0.1);
     } else {
-        positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+        positionDragger->adjustSize(bb);
     }
+    positionDragger->setDraggerAlwaysShown(true);
     sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
 }
 
 
-void PrimitiveShapeItemImpl::onSelectionChanged()
+void PrimitiveShapeItemImpl::detachPositionDragger()
+{
+    draggerConnections.disconnect();
+    draggerPosition = positionDragger->T();
+    sceneLink->removeChild(positionDragger);
+    sceneLink->notifyUpdate();
+    ModelEditDraggerPool::instance()->release(positionDragger);
+    positionDragger = NULL;
+}
+
+
+void PrimitiveShapeItemImpl::onSelectionChanged(bool selected)
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
     if (isselected != selected) {
         isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
         if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
+            attachPositionDragger();
         } else {
-            positionDragger->setDraggerAlwaysHidden(true);
+            detachPositionDragger();
         }
     }
 }
@@ -272,7 +310,7 @@ void PrimitiveShapeItemImpl::onDraggerDragged()
 {
     self->translation = positionDragger->draggedPosition().translation();
     self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    ModelUpdateScheduler::instance()->schedule(self);
 }
 
 PrimitiveShapeItem::~PrimitiveShapeItem()
@@ -283,48 +321,44 @@ PrimitiveShapeItem::~PrimitiveShapeItem()
 
 PrimitiveShapeItemImpl::~PrimitiveShapeItemImpl()
 {
-    conSelectUpdate.disconnect();
+    SelectionTracker::instance()->removeItem(self);
+    if (positionDragger) {
+        detachPositionDragger();
+    }
 }
 
 
 void PrimitiveShapeItemImpl::onUpdated()
 {
-    sceneLink->translation() = self->absTranslation;
-    sceneLink->rotation() = self->absRotation;
-    string pt(primitiveType.selectedSymbol());
-    if (shape) {
-        sceneLink->removeChild(shape);
-        shape = NULL;
+    if (sceneLink->translation() != self->absTranslation ||
+        sceneLink->rotation() != self->absRotation) {
+        updateFlags |= POSE_CHANGED;
     }
-    shape = new SgShape;
-    SgMaterial* material = new SgMaterial;
-    material->setDiffuseColor(primitiveColor);
-    material->setEmissiveColor(Vector3f::Zero());
-    material->setAmbientIntensity(0.0f);
-    material->setTransparency(0.0f);
-    MeshGenerator meshGenerator;
-    if (pt == "Box") {
-        SgMeshPtr mesh = meshGenerator.generateBox(boxSize);
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
+    if (updateFlags & POSE_CHANGED) {
+        sceneLink->translation() = self->absTranslation;
+        sceneLink->rotation() = self->absRotation;
     }
-    if (pt == "Cone") {
-        SgMeshPtr mesh = meshGenerator.generateCone(primitiveRadius, primitiveHeight, true, true);
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
+    if (updateFlags & GEOMETRY_CHANGED) {
+        string pt(primitiveType.selectedSymbol());
+        int type = -1;
+        if (pt == "Box") {
+            type = SgMesh::BOX;
+        } else if (pt == "Sphere") {
+            type = SgMesh::SPHERE;
+        } else if (pt == "Cylinder") {
+            type = SgMesh::CYLINDER;
+        } else if (pt == "Cone") {
+            type = SgMesh::CONE;
+        }
+        shape->setMesh(SharedShapes::primitiveMesh(type, boxSize, primitiveRadius, primitiveHeight));
     }
-    if (pt == "Cylinder") {
-        SgMeshPtr mesh = meshGenerator.generateCylinder(primitiveRadius, primitiveHeight);
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
+    if (updateFlags & COLOR_CHANGED) {
+        material->setDiffuseColor(primitiveColor);
     }
-    if (pt == "Sphere") {
-        SgMeshPtr mesh = meshGenerator.generateSphere(primitiveRadius);
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
+    if (updateFlags) {
+        sceneLink->notifyUpdate();
+        updateFlags = 0;
     }
-    sceneLink->addChildOnce(shape);
-    sceneLink->notifyUpdate();
 }
 
 
@@ -333,115 +367,148 @@ void PrimitiveShapeItemImpl::onPositionChanged()
 }
 
 
-VRMLNodePtr PrimitiveShapeItem::toVRML()
+void PrimitiveShapeItem::writeVRML(VRMLModelWriter& writer)
 {
-    return impl->toVRML();
+    impl->writeVRML(writer);
 }
 
-VRMLNodePtr PrimitiveShapeItemImpl::toVRML()
+void PrimitiveShapeItemImpl::writeVRML(VRMLModelWriter& writer)
 {
-    VRMLTransformPtr trans;
-    trans = new VRMLTransform();
-    trans->translation = self->translation;
-    trans->rotation = self->rotation;
-    VRMLShapePtr shape;
-    shape = new VRMLShape();
+    writer.beginNode("Transform");
+    writer.writePose(self->translation, self->rotation);
+    writer.beginField("children");
+    writer.beginNode("Shape");
+    ostream& os = writer.out();
     string pt(primitiveType.selectedSymbol());
     if (pt == "Box") {
-        VRMLBoxPtr box = new VRMLBox();
-        box->size = boxSize;
-        shape->geometry = box;
+        os << writer.indent() << "geometry Box { size " << boxSize[0] << " " << boxSize[1] << " " << boxSize[2] << " }\n";
+    } else if (pt == "Cone") {
+        os << writer.indent() << "geometry Cone { bottomRadius " << primitiveRadius
+           << " height " << primitiveHeight << " }\n";
+    } else if (pt == "Cylinder") {
+        os << writer.indent() << "geometry Cylinder { radius " << primitiveRadius
+           << " height " << primitiveHeight << " }\n";
+    } else if (pt == "Sphere") {
+        os << writer.indent() << "geometry Sphere { radius " << primitiveRadius << " }\n";
     }
-    if (pt == "Cone") {
-        VRMLConePtr cone = new VRMLCone();
-        cone->bottomRadius = primitiveRadius;
-        cone->height = primitiveHeight;
-        cone->bottom = true;
-        cone->side = true;
-        shape->geometry = cone;
+    os << writer.indent() << "appearance Appearance { material Material { diffuseColor "
+       << FloatText(primitiveColor[0]) << " " << FloatText(primitiveColor[1]) << " "
+       << FloatText(primitiveColor[2]) << " } }\n";
+    writer.endNode();
+    writer.endField();
+    writer.endNode();
+}
+
+
+void PrimitiveShapeItem::writeURDF(URDFWriter& writer)
+{
+    impl->writeURDF(writer);
+}
+
+void PrimitiveShapeItemImpl::writeURDF(URDFWriter& writer)
+{
+    ostream& ss = writer.out();
+    string pt(primitiveType.selectedSymbol());
+    if (pt != "Box" && pt != "Cylinder" && pt != "Sphere") {
+        writer.messageOut() << "[URDF] unsupported primitive type " << pt << endl;
+        return;
     }
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(JointItem::findParentJoint(self), self, p, R);
     if (pt == "Cylinder") {
-        VRMLCylinderPtr cylinder = new VRMLCylinder();
-        cylinder->radius = primitiveRadius;
-        cylinder->height = primitiveHeight;
-        cylinder->top = true;
-        cylinder->bottom = true;
-        cylinder->side = true;
-        shape->geometry = cylinder;
+        // the axis of a VRML cylinder is y while the axis of a URDF cylinder is z
+        R = R * AngleAxis(PI / 2.0, Vector3::UnitX()).toRotationMatrix();
     }
-    if (pt == "Sphere") {
-        VRMLSpherePtr sphere = new VRMLSphere();
-        sphere->radius = primitiveRadius;
-        shape->geometry = sphere;
+    writer.writeShapeJoint(self, self->name());
+    ss << "<link name=\"" << self->name() << "\">\n";
+    for (int i=0; i < 2; i++) {
+        const char* element = (i == 0) ? "visual" : "collision";
+        ss << " <" << element << ">\n";
+        writer.writeOrigin("  ", p, R);
+        ss << "  <geometry>\n";
+        if (pt == "Box") {
+            ss << "   <box size=\"" << boxSize[0] << " " << boxSize[1] << " " << boxSize[2] << "\" />\n";
+        } else if (pt == "Cylinder") {
+            ss << "   <cylinder radius=\"" << primitiveRadius
+               << "\" length=\"" << primitiveHeight << "\" />\n";
+        } else {
+            ss << "   <sphere radius=\"" << primitiveRadius << "\" />\n";
+        }
+        ss << "  </geometry>\n";
+        ss << " </" << element << ">\n";
     }
-    VRMLMaterialPtr mat = new VRMLMaterial();
-    mat->diffuseColor = primitiveColor;
-    VRMLAppearancePtr app = new VRMLAppearance();
-    app->material = mat;
-    shape->appearance = app;
-    trans->children.push_back(shape);
-    return trans;
+    ss << "</link>\n";
 }
 
 
-string PrimitiveShapeItem::toURDF()
+void PrimitiveShapeItem::writeSDF(SDFWriter& writer)
 {
-    return impl->toURDF();
+    impl->writeSDF(writer);
 }
 
-string PrimitiveShapeItemImpl::toURDF()
+void PrimitiveShapeItemImpl::writeSDF(SDFWriter& writer)
 {
-    ostringstream ss;
-    ss << "<link name=\"" << self->name() << "\">" << endl;
-    Affine3 relative;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        Affine3 parent, child;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-    } else {
-        relative.translation() = self->translation;
-        relative.linear() = self->rotation;
-    }
+    ostream& os = writer.out();
     string pt(primitiveType.selectedSymbol());
+    if (pt != "Box" && pt != "Cylinder" && pt != "Sphere") {
+        writer.messageOut() << "[SDF] unsupported primitive type " << pt << endl;
+        return;
+    }
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(self, p, R);
+    if (pt == "Cylinder") {
+        // the axis of a VRML cylinder is y while the axis of a SDF cylinder is z
+        R = R * AngleAxis(PI / 2.0, Vector3::UnitX()).toRotationMatrix();
+    }
     for (int i=0; i < 2; i++) {
-        if (i == 0) {
-            ss << " <visual>" << endl;
-        } else {
-            ss << " <collision>" << endl;
-        }
+        const char* element = (i == 0) ? "visual" : "collision";
+        os << "   <" << element << " name=\"" << self->name() << "_" << element << "\">\n";
+        writer.writePose("    ", p, R);
+        os << "    <geometry>\n";
         if (pt == "Box") {
-            ss << "  <geometry>" << endl;
-            ss << "   <box size=\"" << boxSize << "\" />" << endl;
-            ss << "  </geometry>" << endl;
+            os << "     <box><size>" << boxSize[0] << " " << boxSize[1] << " " << boxSize[2] << "</size></box>\n";
         } else if (pt == "Cylinder") {
-            ss << "  <geometry>" << endl;
-            ss << "   <cylinder radius=\"" << primitiveRadius
-               << " length=\"" << primitiveHeight << "\" />" << endl;
-            ss << "  </geometry>" << endl;
-        } else if (pt == "Sphere") {
-            ss << "  <geometry>" << endl;
-            ss << "   <sphere radius=\"" << primitiveRadius << "\" />" << endl;
-            ss << "  </geometry>" << endl;
+            os << "     <cylinder><radius>" << primitiveRadius << "</radius><length>"
+               << primitiveHeight << "</length></cylinder>\n";
         } else {
-            cout << "[URDF] unsupported primitive type " << pt << endl;
+            os << "     <sphere><radius>" << primitiveRadius << "</radius></sphere>\n";
         }
+        os << "    </geometry>\n";
         if (i == 0) {
-            ss << " </visual>" << endl;
-        } else {
-            ss << " </collision>" << endl;
+            os << "    <material><diffuse>" << FloatText(primitiveColor[0]) << " "
+               << FloatText(primitiveColor[1]) << " " << FloatText(primitiveColor[2])
+               << " 1</diffuse></material>\n";
         }
+        os << "   </" << element << ">\n";
     }
-    return ss.str();
+}
+
+
+void PrimitiveShapeItem::writeGLB(GLBWriter& writer)
+{
+    writer.addShapeNode(impl->shape);
 }
 
 
 bool PrimitiveShapeItemImpl::setPrimitiveType(const std::string& t)
 {
-    return primitiveType.select(t);
+    if (!primitiveType.select(t)) {
+        return false;
+    }
+    updateFlags |= GEOMETRY_CHANGED;
+    return true;
+}
+
+
+bool PrimitiveShapeItemImpl::setPrimitiveType(int index)
+{
+    if (!primitiveType.selectIndex(index)) {
+        return false;
+    }
+    updateFlags |= GEOMETRY_CHANGED;
+    return true;
 }
 
 
@@ -451,6 +518,12 @@ SgNode* PrimitiveShapeItem::getScene()
 }
 
 
+SgPosTransform* PrimitiveShapeItem::sceneTransform()
+{
+    return impl->sceneLink;
+}
+
+
 void PrimitiveShapeItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -461,22 +534,27 @@ void PrimitiveShapeItem::doPutProperties(PutPropertyFunction& putProperty)
 void PrimitiveShapeItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
     putProperty(_("Primitive type"), primitiveType,
-                boost::bind(&Selection::selectIndex, &primitiveType, _1));
+                boost::bind(static_cast<bool(PrimitiveShapeItemImpl::*)(int)>(&PrimitiveShapeItemImpl::setPrimitiveType), this, _1));
     string pt(primitiveType.selectedSymbol());
     if (pt == "Box") {
         putProperty(_("Box size"), str(boxSize),
                     boost::bind(&PrimitiveShapeItemImpl::setBoxSize, this, _1));
     }
     if (pt == "Cone") {
-        putProperty.decimals(4)(_("Cone radius"), primitiveRadius, changeProperty(primitiveRadius));
-        putProperty.decimals(4)(_("Cone height"), primitiveHeight, changeProperty(primitiveHeight));
+        putProperty.decimals(4)(_("Cone radius"), primitiveRadius,
+                                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveRadius, this, _1));
+        putProperty.decimals(4)(_("Cone height"), primitiveHeight,
+                                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveHeight, this, _1));
     }
     if (pt == "Cylinder") {
-        putProperty.decimals(4)(_("Cylinder radius"), primitiveRadius, changeProperty(primitiveRadius));
-        putProperty.decimals(4)(_("Cylinder height"), primitiveHeight, changeProperty(primitiveHeight));
+        putProperty.decimals(4)(_("Cylinder radius"), primitiveRadius,
+                                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveRadius, this, _1));
+        putProperty.decimals(4)(_("Cylinder height"), primitiveHeight,
+                                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveHeight, this, _1));
     }
     if (pt == "Sphere") {
-        putProperty.decimals(4)(_("Sphere radius"), primitiveRadius, changeProperty(primitiveRadius));
+        putProperty.decimals(4)(_("Sphere radius"), primitiveRadius,
+                                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveRadius, this, _1));
     }
     ostringstream oss;
     oss << primitiveColor;
@@ -490,12 +568,35 @@ bool PrimitiveShapeItemImpl::setBoxSize(const std::string& value)
     Vector3 p;
     if(toVector3(value, p)){
         boxSize = p;
+        updateFlags |= GEOMETRY_CHANGED;
         return true;
     }
     return false;
 }
 
 
+bool PrimitiveShapeItemImpl::setPrimitiveRadius(double r)
+{
+    if (r <= 0.0) {
+        return false;
+    }
+    primitiveRadius = r;
+    updateFlags |= GEOMETRY_CHANGED;
+    return true;
+}
+
+
+bool PrimitiveShapeItemImpl::setPrimitiveHeight(double h)
+{
+    if (h <= 0.0) {
+        return false;
+    }
+    primitiveHeight = h;
+    updateFlags |= GEOMETRY_CHANGED;
+    return true;
+}
+
+
 bool PrimitiveShapeItemImpl::setPrimitiveColor(const std::string& value)
 {
     Vector3 p;
@@ -503,6 +604,7 @@ bool PrimitiveShapeItemImpl::setPrimitiveColor(const std::string& value)
         primitiveColor[0] = p[0];
         primitiveColor[1] = p[1];
         primitiveColor[2] = p[2];
+        updateFlags |= COLOR_CHANGED;
         return true;
     }
     return false;
@@ -517,10 +619,8 @@ bool PrimitiveShapeItem::store(Archive& archive)
 
 bool PrimitiveShapeItemImpl::store(Archive& archive)
 {
-    archive.setDoubleFormat("% .6f");
-
-    write(archive, "position", self->translation);
-    write(archive, "attitude", Matrix3(self->rotation));
+    writeExactly(archive, "position", self->translation);
+    writeExactly(archive, "attitude", Matrix3(self->rotation));
 
     return true;
 }
@@ -545,3 +645,42 @@ bool PrimitiveShapeItemImpl::restore(const Archive& archive)
 
     return true;
 }
+
+
+bool PrimitiveShapeItem::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    return impl->storeState(record, writer);
+}
+
+
+bool PrimitiveShapeItemImpl::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    record.type = ModelSnapshotRecord::PRIMITIVE_SHAPE;
+    record.strings[0] = writer.addString(primitiveType.selectedSymbol());
+    for (int i=0; i < 3; i++) {
+        record.params[i] = primitiveColor[i];
+        record.params[3 + i] = boxSize[i];
+    }
+    record.params[6] = primitiveRadius;
+    record.params[7] = primitiveHeight;
+    return true;
+}
+
+
+void PrimitiveShapeItem::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    impl->restoreState(record, reader);
+}
+
+
+void PrimitiveShapeItemImpl::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    primitiveType.select(reader.string(record.strings[0]));
+    for (int i=0; i < 3; i++) {
+        primitiveColor[i] = record.params[i];
+        boxSize[i] = record.params[3 + i];
+    }
+    primitiveRadius = record.params[6];
+    primitiveHeight = record.params[7];
+    updateFlags |= GEOMETRY_CHANGED | COLOR_CHANGED;
+}
@@ -29,10 +29,15 @@ public:
     PrimitiveShapeItem(const PrimitiveShapeItem& org);
     virtual ~PrimitiveShapeItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
+    void writeGLB(GLBWriter& writer);
 
     virtual SgNode* getScene();
+    virtual SgPosTransform* sceneTransform();
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 
 protected:
     virtual Item* doDuplicate() const;
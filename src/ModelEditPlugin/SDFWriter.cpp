@@ -0,0 +1,174 @@
+/**
+   @file
+*/
+
+#include "SDFWriter.h"
+#include "EditableModelBase.h"
+#include "DoubleFormatter.h"
+#include "ModelFileStream.h"
+#include "JointItem.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/NullOut>
+#include <boost/filesystem.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+
+SDFWriter::SDFWriter(std::ostream& os)
+    : os(os),
+      messageOut_(&nullout()),
+      currentLink_(0)
+{
+    setPrecision(0);
+}
+
+
+void SDFWriter::setMessageSink(std::ostream& os)
+{
+    messageOut_ = &os;
+}
+
+
+void SDFWriter::setPrecision(int precision)
+{
+    os.imbue(DoubleFormatter::locale(precision));
+}
+
+
+void SDFWriter::setOutFileName(const std::string& filename)
+{
+    outDirectory_ = boost::filesystem::path(filename).parent_path().string();
+}
+
+
+void SDFWriter::writeModel(Item* modelItem)
+{
+    os << "<?xml version=\"1.0\"?>\n";
+    os << "<sdf version=\"1.5\">\n";
+    os << " <model name=\"" << modelItem->name() << "\">\n";
+    writeUnattachedItems(modelItem);
+    writeJoints(modelItem);
+    os << " </model>\n";
+    os << "</sdf>\n";
+}
+
+
+/**
+   Writes the elements of the non-joint descendants of the item, which
+   belong to the current link.
+*/
+void SDFWriter::writeLinkElements(Item* item)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        if(dynamic_cast<JointItem*>(child)){
+            continue;
+        }
+        EditableModelBase* modelItem = dynamic_cast<EditableModelBase*>(child);
+        if(modelItem){
+            modelItem->writeSDF(*this);
+        }
+        writeLinkElements(child);
+    }
+}
+
+
+/**
+   Writes each item which is not below any joint as a link fixed to the world,
+   which contains the elements of the item and its non-joint descendants, as
+   the URDF writer does with the shape joints.
+*/
+void SDFWriter::writeUnattachedItems(Item* item)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        if(dynamic_cast<JointItem*>(child)){
+            continue;
+        }
+        EditableModelBase* modelItem = dynamic_cast<EditableModelBase*>(child);
+        if(!modelItem){
+            writeUnattachedItems(child);
+            continue;
+        }
+        beginLink(modelItem, modelItem->name());
+        modelItem->writeSDF(*this);
+        writeLinkElements(modelItem);
+        endLink();
+        os << "  <joint name=\"" << modelItem->name() << "_JOINT\" type=\"fixed\">\n";
+        os << "   <parent>world</parent>\n";
+        os << "   <child>" << modelItem->name() << "</child>\n";
+        os << "  </joint>\n";
+    }
+}
+
+
+/**
+   Writes the joint items which are the nearest joint descendants of the item.
+*/
+void SDFWriter::writeJoints(Item* item)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        JointItem* joint = dynamic_cast<JointItem*>(child);
+        if(joint){
+            joint->writeSDF(*this);
+        } else {
+            writeJoints(child);
+        }
+    }
+}
+
+
+void SDFWriter::beginLink(EditableModelBase* linkItem, const std::string& name)
+{
+    currentLink_ = linkItem;
+    os << "  <link name=\"" << name << "\">\n";
+    writePose("   ", linkItem->absTranslation, linkItem->absRotation);
+}
+
+
+void SDFWriter::endLink()
+{
+    os << "  </link>\n";
+    currentLink_ = 0;
+}
+
+
+void SDFWriter::getRelativePose(EditableModelBase* item, Vector3& out_p, Matrix3& out_R) const
+{
+    if(currentLink_){
+        const Matrix3 Rt = currentLink_->absRotation.transpose();
+        out_p = Rt * (item->absTranslation - currentLink_->absTranslation);
+        out_R = Rt * item->absRotation;
+    } else {
+        out_p = item->absTranslation;
+        out_R = item->absRotation;
+    }
+}
+
+
+void SDFWriter::writePose(const char* indent, const Vector3& p, const Matrix3& R)
+{
+    const Vector3 rpy = rpyFromRot(R);
+    os << indent << "<pose>" << p[0] << " " << p[1] << " " << p[2] << " "
+       << rpy[0] << " " << rpy[1] << " " << rpy[2] << "</pose>\n";
+}
+
+
+bool SDFWriter::save(Item* modelItem, const std::string& filename, std::ostream& messageOut,
+                     int numMeshThreads)
+{
+    ModelOutputFile file(filename);
+    if(!file.isOpen()){
+        return false;
+    }
+    SDFWriter writer(file.stream());
+    writer.setMessageSink(messageOut);
+    writer.setOutFileName(filename);
+    writer.writeModel(modelItem);
+    if(!file.close()){
+        return false;
+    }
+    bool exported = writer.meshExporter().exportMeshes(writer.outDirectory(), numMeshThreads);
+    writer.meshExporter().putSummary(messageOut);
+    return exported;
+}
@@ -0,0 +1,73 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_SDF_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_SDF_WRITER_H
+
+#include <cnoid/Item>
+#include <cnoid/EigenTypes>
+#include "MeshExporter.h"
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class EditableModelBase;
+
+/**
+   Writes the SDF description of an item tree to a stream in one traversal.
+   Each joint item is written as a link, which contains the elements of the
+   non-joint items below it, and the joint connecting the link to its parent.
+   The items which are not below any joint are written as links fixed to the
+   world.
+*/
+class CNOID_EXPORT SDFWriter
+{
+public:
+    SDFWriter(std::ostream& os);
+
+    std::ostream& out() { return os; }
+
+    /// stream of the warnings, which are discarded by default
+    void setMessageSink(std::ostream& os);
+    std::ostream& messageOut() { return *messageOut_; }
+
+    /// significant digits of the doubles, 0 for the shortest exact digits
+    void setPrecision(int precision);
+
+    void setOutFileName(const std::string& filename);
+    const std::string& outDirectory() const { return outDirectory_; }
+
+    /// meshes referred by the document, exported by save() after the document is written
+    MeshExporter& meshExporter() { return meshExporter_; }
+
+    void writeModel(Item* modelItem);
+    void writeUnattachedItems(Item* item);
+    void writeLinkElements(Item* item);
+    void writeJoints(Item* item);
+
+    void beginLink(EditableModelBase* linkItem, const std::string& name);
+    void endLink();
+    EditableModelBase* currentLink() const { return currentLink_; }
+
+    /// pose of the item relative to the current link
+    void getRelativePose(EditableModelBase* item, Vector3& out_p, Matrix3& out_R) const;
+    void writePose(const char* indent, const Vector3& p, const Matrix3& R);
+
+    /// the meshes are exported with numMeshThreads threads, or the hardware threads when it is zero
+    static bool save(Item* modelItem, const std::string& filename, std::ostream& messageOut,
+                     int numMeshThreads = 0);
+
+private:
+    std::ostream& os;
+    std::ostream* messageOut_;
+    EditableModelBase* currentLink_;
+    std::string outDirectory_;
+    MeshExporter meshExporter_;
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+/**
+   @file
+*/
+
+#include "SelectionTracker.h"
+#include <cnoid/ItemTreeView>
+#include <boost/bind.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+
+namespace cnoid {
+
+class SelectionTrackerImpl
+{
+public:
+    typedef boost::function<void(bool on)> Callback;
+    map<Item*, Callback> callbacks;
+    set<Item*> selectedItems;
+    Connection conSelectionChanged;
+    int blockCount;
+    bool hasPendingChange;
+    // the selection given by setSelectedItems during a block
+    bool hasPendingItems;
+    ItemList<Item> pendingItems;
+
+    SelectionTrackerImpl() : blockCount(0), hasPendingChange(false), hasPendingItems(false) { }
+
+    bool findCallback(Item* item, Callback& out_callback);
+    void onSelectionChanged();
+    void setSelectedItems(const ItemList<Item>& items);
+};
+
+}
+
+
+void SelectionTracker::initializeClass(ExtensionManager* ext)
+{
+    static bool initialized = false;
+
+    if(!initialized){
+        ItemTreeView* view = ItemTreeView::mainInstance();
+        if(view){
+            SelectionTrackerImpl* impl = instance()->impl;
+            impl->conSelectionChanged = view->sigSelectionChanged().connect(
+                boost::bind(&SelectionTrackerImpl::onSelectionChanged, impl));
+        }
+        initialized = true;
+    }
+}
+
+
+SelectionTracker* SelectionTracker::instance()
+{
+    static SelectionTracker tracker;
+    return &tracker;
+}
+
+
+SelectionTracker::SelectionTracker()
+{
+    impl = new SelectionTrackerImpl;
+}
+
+
+SelectionTracker::~SelectionTracker()
+{
+    impl->conSelectionChanged.disconnect();
+    delete impl;
+}
+
+
+void SelectionTracker::addItem(Item* item, const boost::function<void(bool on)>& func)
+{
+    impl->callbacks[item] = func;
+}
+
+
+void SelectionTracker::removeItem(Item* item)
+{
+    impl->callbacks.erase(item);
+    impl->selectedItems.erase(item);
+}
+
+
+bool SelectionTracker::isSelected(Item* item) const
+{
+    return impl->selectedItems.find(item) != impl->selectedItems.end();
+}
+
+
+void SelectionTracker::blockUpdates()
+{
+    ++impl->blockCount;
+}
+
+
+void SelectionTracker::unblockUpdates()
+{
+    if(impl->blockCount > 0 && --impl->blockCount == 0 && impl->hasPendingChange){
+        impl->hasPendingChange = false;
+        if(impl->hasPendingItems){
+            ItemList<Item> items;
+            std::swap(items, impl->pendingItems);
+            impl->hasPendingItems = false;
+            impl->setSelectedItems(items);
+        } else {
+            impl->onSelectionChanged();
+        }
+    }
+}
+
+
+void SelectionTracker::setSelectedItems(const ItemList<Item>& items)
+{
+    if(impl->blockCount > 0){
+        impl->hasPendingChange = true;
+        impl->hasPendingItems = true;
+        impl->pendingItems = items;
+        return;
+    }
+    impl->setSelectedItems(items);
+}
+
+
+bool SelectionTrackerImpl::findCallback(Item* item, Callback& out_callback)
+{
+    map<Item*, Callback>::iterator p = callbacks.find(item);
+    if(p == callbacks.end()){
+        return false;
+    }
+    out_callback = p->second;
+    return true;
+}
+
+
+void SelectionTrackerImpl::onSelectionChanged()
+{
+    if(blockCount > 0){
+        hasPendingChange = true;
+        hasPendingItems = false;
+        pendingItems.clear();
+        return;
+    }
+    setSelectedItems(ItemTreeView::mainInstance()->selectedItems());
+}
+
+
+void SelectionTrackerImpl::setSelectedItems(const ItemList<Item>& items)
+{
+    set<Item*> current;
+    for(size_t i=0; i < items.size(); ++i){
+        Item* item = items.get(i);
+        if(callbacks.find(item) != callbacks.end()){
+            current.insert(item);
+        }
+    }
+
+    vector<Item*> deselected;
+    for(set<Item*>::iterator p = selectedItems.begin(); p != selectedItems.end(); ++p){
+        if(current.find(*p) == current.end()){
+            deselected.push_back(*p);
+        }
+    }
+    vector<Item*> selected;
+    for(set<Item*>::iterator p = current.begin(); p != current.end(); ++p){
+        if(selectedItems.find(*p) == selectedItems.end()){
+            selected.push_back(*p);
+        }
+    }
+    selectedItems.swap(current);
+
+    // a callback may remove items from the tracker, so look them up each time
+    Callback callback;
+    for(size_t i=0; i < deselected.size(); ++i){
+        if(findCallback(deselected[i], callback)){
+            callback(false);
+        }
+    }
+    for(size_t i=0; i < selected.size(); ++i){
+        if(findCallback(selected[i], callback)){
+            callback(true);
+        }
+    }
+}
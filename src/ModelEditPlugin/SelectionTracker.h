@@ -0,0 +1,58 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_SELECTION_TRACKER_H
+#define CNOID_EDITMODEL_PLUGIN_SELECTION_TRACKER_H
+
+#include <cnoid/Item>
+#include <cnoid/ItemList>
+#include <boost/function.hpp>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SelectionTrackerImpl;
+
+/**
+   Plugin-level dispatcher of the item selection state.
+   It is the only receiver of ItemTreeView::sigSelectionChanged in the plugin.
+   The previous and the current selection are compared and only the items
+   whose state has changed are notified.
+*/
+class CNOID_EXPORT SelectionTracker
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+    static SelectionTracker* instance();
+
+    void addItem(Item* item, const boost::function<void(bool on)>& func);
+    void removeItem(Item* item);
+    bool isSelected(Item* item) const;
+
+    /**
+       Dispatches the given selection in the same way as a selection of the
+       item tree view, which is used when there is no view, e.g. by the
+       benchmark of the model converter. The selection is deferred while
+       the updates are blocked.
+    */
+    void setSelectedItems(const ItemList<Item>& items);
+
+    /**
+       Defers the dispatch while many items are inserted or checked at once.
+       A selection change during the block is processed once when the last
+       block is released.
+    */
+    void blockUpdates();
+    void unblockUpdates();
+
+private:
+    SelectionTracker();
+    ~SelectionTracker();
+
+    SelectionTrackerImpl* impl;
+};
+
+}
+
+#endif
@@ -3,9 +3,10 @@
 */
 
 #include "SensorItem.h"
+#include "SharedShapes.h"
+#include "SelectionTracker.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
-#include <cnoid/ItemTreeView>
 #include <cnoid/ItemManager>
 #include <cnoid/SceneBody>
 #include <cnoid/Sensor>
@@ -13,9 +14,13 @@
 #include <cnoid/RangeSensor>
 #include <cnoid/VRMLBody>
 #include "ModelEditDragger.h"
+#include "ModelUpdateScheduler.h"
+#include "ModelSnapshot.h"
+#include "DoubleFormatter.h"
+#include "SDFWriter.h"
+#include "VRMLModelWriter.h"
+#include <cnoid/ConnectionSet>
 #include "JointItem.h"
-#include <cnoid/MeshNormalGenerator>
-#include <cnoid/MeshGenerator>
 #include <cnoid/RangeCamera>
 #include <boost/bind.hpp>
 #include <iostream>
@@ -26,8 +31,6 @@ using namespace cnoid;
 
 namespace {
 
-const char* axisNames[3] = { "x", "y", "z" };
-
 const bool TRACE_FUNCTIONS = false;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
@@ -42,6 +45,8 @@ class SensorItemImpl
 public:
     SensorItem* self;
     Device* device;
+    // the device created for the sensor type, which no body owns
+    DevicePtr createdDevice;
     int sensorId;
     Selection sensorType;
     Selection cameraType;
@@ -64,12 +69,11 @@ public:
 
     SceneLinkPtr sceneLink;
     SgScaleTransformPtr defaultAxesScale;
-    SgMaterialPtr axisMaterials[3];
-    double axisCylinderNormalizedRadius;
-    SgPosTransformPtr sensorShape;
+    SgShapePtr sensorShape;
 
     ModelEditDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    Affine3 draggerPosition;
+    ConnectionSet draggerConnections;
 
     SensorItemImpl(SensorItem* self);
     SensorItemImpl(SensorItem* self, Device* dev);
@@ -78,23 +82,31 @@ public:
     
     void init();
     void syncDevice();
-    void onSelectionChanged();
+    void createDevice();
+    void updateDevice();
+    bool onTypeChanged(Selection* type, int index);
+    void onSelectionChanged(bool on);
     void attachPositionDragger();
+    void detachPositionDragger();
     void onDraggerStarted();
     void onDraggerDragged();
     void onUpdated();
+    void updateSensorShape();
     double radius() const;
     void setRadius(double val);
     bool onMaxForceChanged(const std::string& value);
     bool onMaxTorqueChanged(const std::string& value);
     bool onMaxAngularVelocityChanged(const std::string& value);
     bool onMaxAccelerationChanged(const std::string& value);
-    VRMLNodePtr toVRML();
-    string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 };
 
 }
@@ -121,7 +133,8 @@ SensorItem::SensorItem()
 SensorItemImpl::SensorItemImpl(SensorItem* self)
     : self(self)
 {
-    device = new Camera();
+    createdDevice = new Camera();
+    device = createdDevice.get();
     init();
 }
 
@@ -157,7 +170,8 @@ SensorItem::SensorItem(const SensorItem& org)
 
 SensorItemImpl::SensorItemImpl(SensorItem* self, const SensorItemImpl& org)
     : self(self),
-      device(org.device)
+      device(org.device),
+      createdDevice(org.createdDevice)
 {
     init();
     syncDevice();
@@ -185,52 +199,32 @@ void SensorItemImpl::init()
     cameraType.setSymbol(5, "COLOR_POINT_CLOUD");
     cameraType.select("COLOR");
 
+    resolutionX = 0;
+    resolutionY = 0;
+    nearDistance = 0.0;
+    farDistance = 0.0;
+    fieldOfView = 0.0;
+    frameRate = 0.0;
+    scanAngle = 0.0;
+    scanStep = 0.0;
+    scanRate = 0.0;
+    minDistance = 0.0;
+    maxDistance = 0.0;
+
     sceneLink = new SceneLink(new Link());
-    sensorShape = NULL;
+    sensorShape = new SgShape;
+    sensorShape->setMaterial(SharedShapes::sensorMaterial());
 
-    axisCylinderNormalizedRadius = 0.04;
-    
     defaultAxesScale = new SgScaleTransform;
-    
-    for(int i=0; i < 3; ++i){
-        SgMaterial* material = new SgMaterial;
-        Vector3f color(0.2f, 0.2f, 0.2f);
-        color[i] = 1.0f;
-        material->setDiffuseColor(Vector3f::Zero());
-        material->setEmissiveColor(color);
-        material->setAmbientIntensity(0.0f);
-        material->setTransparency(0.6f);
-        axisMaterials[i] = material;
-    }
-
-    MeshGenerator meshGenerator;
-    SgMeshPtr mesh = meshGenerator.generateArrow(1.8, 0.08, 0.1, 2.5);
-    for(int i=0; i < 3; ++i){
-        SgShape* shape = new SgShape;
-        shape->setMesh(mesh);
-        shape->setMaterial(axisMaterials[i]);
-        
-        SgPosTransform* arrow = new SgPosTransform;
-        arrow->addChild(shape);
-        if(i == 0){
-            arrow->setRotation(AngleAxis(-PI / 2.0, Vector3::UnitZ()));
-        } else if(i == 2){
-            arrow->setRotation(AngleAxis( PI / 2.0, Vector3::UnitX()));
-        }
-        SgInvariantGroup* invariant = new SgInvariantGroup;
-        invariant->setName(axisNames[i]);
-        invariant->addChild(arrow);
-        defaultAxesScale->addChild(invariant);
-    }
+    defaultAxesScale->addChild(SharedShapes::axesGizmo());
     sceneLink->addChild(defaultAxesScale);
 
-    attachPositionDragger();
-    
     setRadius(0.15);
 
     self->sigUpdated().connect(boost::bind(&SensorItemImpl::onUpdated, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&SensorItemImpl::onSelectionChanged, this));
+    SelectionTracker::instance()->addItem(self, boost::bind(&SensorItemImpl::onSelectionChanged, this, _1));
     isselected = false;
+    draggerPosition.setIdentity();
 
     onUpdated();
 }
@@ -301,23 +295,90 @@ void SensorItemImpl::syncDevice()
 }
 
 
-void SensorItemImpl::onSelectionChanged()
+/**
+   Replaces the device with a new one of the selected sensor and camera
+   types, which keeps the name, the id, the link and the local pose of the
+   previous device. The parameters are set by updateDevice.
+*/
+void SensorItemImpl::createDevice()
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
+    string st(sensorType.selectedSymbol());
+    string ct(cameraType.selectedSymbol());
+    DevicePtr newDevice;
+    if (st == "force") {
+        newDevice = new ForceSensor;
+    } else if (st == "gyro") {
+        newDevice = new RateGyroSensor;
+    } else if (st == "acceleration") {
+        newDevice = new AccelerationSensor;
+    } else if (st == "range") {
+        newDevice = new RangeSensor;
+    } else if (ct == "NONE" || ct == "COLOR") {
+        newDevice = new Camera;
+    } else {
+        newDevice = new RangeCamera;
+    }
+    newDevice->setName(device->name());
+    newDevice->setId(sensorId);
+    newDevice->setLink(device->link());
+    newDevice->T_local() = device->T_local();
+    createdDevice = newDevice;
+    device = newDevice.get();
+}
+
+
+void SensorItemImpl::updateDevice()
+{
+    device->setId(sensorId);
+    if (ForceSensor* fsensor = dynamic_cast<ForceSensor*>(device)) {
+        fsensor->F_max().head<3>() = maxForce;
+        fsensor->F_max().tail<3>() = maxTorque;
+    } else if (RateGyroSensor* gyro = dynamic_cast<RateGyroSensor*>(device)) {
+        gyro->w_max() = maxAngularVelocity;
+    } else if (AccelerationSensor* asensor = dynamic_cast<AccelerationSensor*>(device)) {
+        asensor->dv_max() = maxAcceleration;
+    } else if (RangeSensor* rsensor = dynamic_cast<RangeSensor*>(device)) {
+        rsensor->setYawRange(scanAngle);
+        rsensor->setYawStep(scanStep);
+        rsensor->setFrameRate(scanRate);
+        rsensor->setMinDistance(minDistance);
+        rsensor->setMaxDistance(maxDistance);
+    } else if (Camera* camera = dynamic_cast<Camera*>(device)) {
+        string ct(cameraType.selectedSymbol());
+        camera->setResolution(resolutionX, resolutionY);
+        camera->setNearClipDistance(nearDistance);
+        camera->setFarClipDistance(farDistance);
+        camera->setFieldOfView(fieldOfView);
+        camera->setFrameRate(frameRate);
+        bool hasColor = (ct == "COLOR" || ct == "COLOR_DEPTH" || ct == "COLOR_POINT_CLOUD");
+        camera->setImageType(hasColor ? Camera::COLOR_IMAGE : Camera::NO_IMAGE);
+        if (RangeCamera* range = dynamic_cast<RangeCamera*>(device)) {
+            range->setOrganized(ct == "DEPTH" || ct == "COLOR_DEPTH");
         }
     }
+}
+
+
+// the sensor and the camera types determine the class of the device
+bool SensorItemImpl::onTypeChanged(Selection* type, int index)
+{
+    if (!type->selectIndex(index)) {
+        return false;
+    }
+    createDevice();
+    updateDevice();
+    return true;
+}
+
+
+void SensorItemImpl::onSelectionChanged(bool selected)
+{
     if (isselected != selected) {
         isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
         if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
+            attachPositionDragger();
         } else {
-            positionDragger->setDraggerAlwaysHidden(true);
+            detachPositionDragger();
         }
     }
 }
@@ -332,20 +393,36 @@ double SensorItemImpl::radius() const
 void SensorItemImpl::setRadius(double r)
 {
     defaultAxesScale->setScale(r);
-    positionDragger->setRadius(r * 1.5);
+    if (positionDragger) {
+        positionDragger->setRadius(r * 1.5);
+    }
     sceneLink->notifyUpdate();
 }
 
 
 void SensorItemImpl::attachPositionDragger()
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&SensorItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&SensorItemImpl::onDraggerDragged, this));
-    positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+    positionDragger = ModelEditDraggerPool::instance()->acquire();
+    draggerConnections.add(
+        positionDragger->sigDragStarted().connect(boost::bind(&SensorItemImpl::onDraggerStarted, this)));
+    draggerConnections.add(
+        positionDragger->sigPositionDragged().connect(boost::bind(&SensorItemImpl::onDraggerDragged, this)));
+    positionDragger->T() = draggerPosition;
+    positionDragger->setRadius(radius() * 1.5);
+    positionDragger->setDraggerAlwaysShown(true);
     sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
+}
+
+
+void SensorItemImpl::detachPositionDragger()
+{
+    draggerConnections.disconnect();
+    draggerPosition = positionDragger->T();
+    sceneLink->removeChild(positionDragger);
+    sceneLink->notifyUpdate();
+    ModelEditDraggerPool::instance()->release(positionDragger);
+    positionDragger = NULL;
 }
 
 
@@ -358,7 +435,7 @@ void SensorItemImpl::onDraggerDragged()
 {
     self->translation = positionDragger->draggedPosition().translation();
     self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    ModelUpdateScheduler::instance()->schedule(self);
  }
 
 SensorItem::~SensorItem()
@@ -369,7 +446,10 @@ SensorItem::~SensorItem()
 
 SensorItemImpl::~SensorItemImpl()
 {
-    conSelectUpdate.disconnect();
+    SelectionTracker::instance()->removeItem(self);
+    if (positionDragger) {
+        detachPositionDragger();
+    }
 }
 
 
@@ -383,108 +463,32 @@ void SensorItemImpl::onUpdated()
 {
     sceneLink->translation() = self->absTranslation;
     sceneLink->rotation() = self->absRotation;
+    updateSensorShape();
+    sceneLink->notifyUpdate();
+}
 
-    // draw shape indicator for sensors
-    if (sensorShape) {
-        sceneLink->removeChild(sensorShape);
-        sensorShape = NULL;
-    }
+
+/**
+   The indicator meshes are shared by the sensors with the same parameters,
+   so only a lookup is done when the sensor is just moved.
+*/
+void SensorItemImpl::updateSensorShape()
+{
+    SgMesh* mesh = 0;
     string st(sensorType.selectedSymbol());
     if (st == "camera") {
-        sensorShape = new SgPosTransform;
-        SgShapePtr shape = new SgShape;
-        SgMaterialPtr material = new SgMaterial;
-        material->setDiffuseColor(Vector3f(0.0f, 0.0f, 1.0f));
-        material->setEmissiveColor(Vector3f::Zero());
-        material->setAmbientIntensity(0.0f);
-        material->setTransparency(0.5f);
-        
-        double w = 0.50;
-        double h = 0.40;
-        if (fieldOfView > 0.0 && resolutionX > 0.0 && resolutionY > 0.0) {
-            double aspect = (double)resolutionX / (double)resolutionY;
-            if (aspect >= 1.0) {
-                w = 2.0 * farDistance * tan(fieldOfView / 2.0);
-                h = w / aspect;
-            } else {
-                h = 2.0 * farDistance * tan(fieldOfView / 2.0);
-                w = h * aspect;
-            }
-        }
-        SgMeshPtr mesh = new SgMesh;
-        SgVertexArray& vertices = *mesh->setVertices(new SgVertexArray());
-        vertices.reserve(8);
-        vertices.push_back(Vector3f(-w/2, -h/2, -farDistance));
-        vertices.push_back(Vector3f(-w/2,  h/2, -farDistance));
-        vertices.push_back(Vector3f( w/2,  h/2, -farDistance));
-        vertices.push_back(Vector3f( w/2, -h/2, -farDistance));
-        w *= nearDistance/farDistance;
-        h *= nearDistance/farDistance;
-        vertices.push_back(Vector3f(-w/2, -h/2, -nearDistance));
-        vertices.push_back(Vector3f(-w/2,  h/2, -nearDistance));
-        vertices.push_back(Vector3f( w/2,  h/2, -nearDistance));
-        vertices.push_back(Vector3f( w/2, -h/2, -nearDistance));
-        
-        mesh->reserveNumTriangles(12);
-        mesh->addTriangle(0,1,2);
-        mesh->addTriangle(0,2,3);
-        mesh->addTriangle(0,3,4);
-        mesh->addTriangle(4,3,7);
-        mesh->addTriangle(0,4,1);
-        mesh->addTriangle(4,5,1);
-        mesh->addTriangle(1,5,6);
-        mesh->addTriangle(1,6,2);
-        mesh->addTriangle(6,7,3);
-        mesh->addTriangle(6,3,2);
-        mesh->addTriangle(5,4,7);
-        mesh->addTriangle(5,7,6);
-
-        MeshNormalGenerator normalGenerator;
-        normalGenerator.generateNormals(mesh, 0);
-        
-        mesh->updateBoundingBox();
-        
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
-        sensorShape->addChild(shape);
-        sceneLink->addChildOnce(sensorShape);
-    }else if (st == "range") {
-        sensorShape = new SgPosTransform;
-        SgShapePtr shape = new SgShape;
-        SgMaterialPtr material = new SgMaterial;
-        material->setDiffuseColor(Vector3f(0.0f, 0.0f, 1.0f));
-        material->setEmissiveColor(Vector3f::Zero());
-        material->setAmbientIntensity(0.0f);
-        material->setTransparency(0.5f);
-
-        const int ndiv = scanAngle/0.2+1;
-        SgMeshPtr mesh = new SgMesh;
-        SgVertexArray& vertices = *mesh->setVertices(new SgVertexArray());
-        vertices.reserve((ndiv+1)*2);
-        for (int i=0; i<=ndiv; i++){
-            double c = cos(scanAngle/ndiv*i-scanAngle/2);
-            double s = sin(scanAngle/ndiv*i-scanAngle/2);
-            vertices.push_back(Vector3f(minDistance*s, 0, -minDistance*c));
-            vertices.push_back(Vector3f(maxDistance*s, 0, -maxDistance*c));
-        }
-        
-        mesh->reserveNumTriangles(ndiv*2);
-        for (int i=0; i<ndiv; i++){
-            mesh->addTriangle(i*2+2,i*2+1,i*2  );
-            mesh->addTriangle(i*2+2,i*2+3,i*2+1);
+        mesh = SharedShapes::cameraFrustum(fieldOfView, resolutionX, resolutionY, nearDistance, farDistance);
+    } else if (st == "range") {
+        mesh = SharedShapes::rangeSensorFan(scanAngle, minDistance, maxDistance);
+    }
+    if (mesh) {
+        if (sensorShape->mesh() != mesh) {
+            sensorShape->setMesh(mesh);
         }
-
-        MeshNormalGenerator normalGenerator;
-        normalGenerator.generateNormals(mesh, 0);
-        
-        mesh->updateBoundingBox();
-        
-        shape->setMesh(mesh);
-        shape->setMaterial(material);
-        sensorShape->addChild(shape);
         sceneLink->addChildOnce(sensorShape);
+    } else {
+        sceneLink->removeChild(sensorShape);
     }
-    sceneLink->notifyUpdate();
 }
 
 
@@ -518,6 +522,12 @@ SgNode* SensorItem::getScene()
 }
 
 
+SgPosTransform* SensorItem::sceneTransform()
+{
+    return impl->sceneLink;
+}
+
+
 void SensorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -530,11 +540,11 @@ void SensorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     ostringstream oss;
     putProperty.decimals(4)(_("Sensor ID"), sensorId, changeProperty(sensorId));
     putProperty(_("Sensor type"), sensorType,
-                boost::bind(&Selection::selectIndex, &sensorType, _1));
+                boost::bind(&SensorItemImpl::onTypeChanged, this, &sensorType, _1));
     string st(sensorType.selectedSymbol());
     if (st == "camera") {
         putProperty(_("Camera type"), cameraType,
-                    boost::bind(&Selection::selectIndex, &cameraType, _1));
+                    boost::bind(&SensorItemImpl::onTypeChanged, this, &cameraType, _1));
         putProperty.decimals(4).min(0)(_("Resolution X"), resolutionX, changeProperty(resolutionX));
         putProperty.decimals(4).min(0)(_("Resolution Y"), resolutionY, changeProperty(resolutionY));
         putProperty.decimals(4).min(0)(_("Frame rate"), frameRate, changeProperty(frameRate));
@@ -597,78 +607,123 @@ bool SensorItemImpl::onMaxAccelerationChanged(const std::string& value)
     return false;
 }
 
-VRMLNodePtr SensorItem::toVRML()
+void SensorItem::writeVRML(VRMLModelWriter& writer)
 {
-    return impl->toVRML();
+    impl->writeVRML(writer);
 }
 
 
-VRMLNodePtr SensorItemImpl::toVRML()
+void SensorItemImpl::writeVRML(VRMLModelWriter& writer)
 {
-    VRMLTransformPtr node = NULL;
     string st(sensorType.selectedSymbol());
     if (st == "force") {
-        VRMLForceSensorPtr fnode = new VRMLForceSensor();
-        fnode->sensorId = sensorId;
-        fnode->maxForce = maxForce;
-        fnode->maxTorque = maxTorque;
-        node = fnode;
+        writer.beginNode("ForceSensor", self->name());
+        writer.writeField("maxForce", maxForce);
+        writer.writeField("maxTorque", maxTorque);
     } else if (st == "gyro") {
-        VRMLGyroPtr gnode = new VRMLGyro();
-        gnode->sensorId = sensorId;
-        gnode->maxAngularVelocity = maxAngularVelocity;
-        node = gnode;
+        writer.beginNode("Gyro", self->name());
+        writer.writeField("maxAngularVelocity", maxAngularVelocity);
     } else if (st == "acceleration") {
-        VRMLAccelerationSensorPtr anode = new VRMLAccelerationSensor();
-        anode->sensorId = sensorId;
-        anode->maxAcceleration = maxAcceleration;
-        node = anode;
+        writer.beginNode("AccelerationSensor", self->name());
+        writer.writeField("maxAcceleration", maxAcceleration);
     } else if (st == "range") {
-        VRMLRangeSensorPtr rnode = new VRMLRangeSensor();
-        rnode->sensorId = sensorId;
-        rnode->scanAngle = scanAngle;
-        rnode->scanStep = scanStep;
-        rnode->scanRate = scanRate;
-        rnode->minDistance = minDistance;
-        rnode->maxDistance = maxDistance;
-        node = rnode;
+        writer.beginNode("RangeSensor", self->name());
+        writer.writeField("scanAngle", scanAngle);
+        writer.writeField("scanStep", scanStep);
+        writer.writeField("scanRate", scanRate);
+        writer.writeField("minDistance", minDistance);
+        writer.writeField("maxDistance", maxDistance);
     } else if (st == "camera") {
-        VRMLVisionSensorPtr cnode = new VRMLVisionSensor();
-        cnode->sensorId = sensorId;
-        cnode->type = cameraType.selectedSymbol();
-        cnode->width = resolutionX;
-        cnode->height = resolutionY;
-        cnode->frameRate = frameRate;
-        cnode->fieldOfView = fieldOfView;
-        cnode->frontClipDistance = nearDistance;
-        cnode->backClipDistance = farDistance;
-        node = cnode;
+        writer.beginNode("VisionSensor", self->name());
+        writer.writeField("type", string(cameraType.selectedSymbol()));
+        writer.writeField("width", resolutionX);
+        writer.writeField("height", resolutionY);
+        writer.writeField("frameRate", frameRate);
+        writer.writeField("fieldOfView", fieldOfView);
+        writer.writeField("frontClipDistance", nearDistance);
+        writer.writeField("backClipDistance", farDistance);
+    } else {
+        return;
     }
-    if (node) {
-        node->defName = self->name();
-        node->translation = self->translation;
-        node->rotation = self->rotation;
-        for(Item* child = self->childItem(); child; child = child->nextItem()){
-            EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-            if (item) {
-                VRMLNodePtr childnode = item->toVRML();
-                node->children.push_back(childnode);
-            }
-        }
-    }
-    return node;
+    writer.writeField("sensorId", sensorId);
+    writer.writePose(self->translation, self->rotation);
+    writer.writeChildren(self);
+    writer.endNode();
+}
+
+
+void SensorItem::writeURDF(URDFWriter& writer)
+{
+    impl->writeURDF(writer);
 }
 
 
-string SensorItem::toURDF()
+void SensorItemImpl::writeURDF(URDFWriter& writer)
 {
-    return impl->toURDF();
+    // sensors are not described in URDF
 }
 
 
-string SensorItemImpl::toURDF()
+void SensorItem::writeSDF(SDFWriter& writer)
 {
-    return NULL;
+    impl->writeSDF(writer);
+}
+
+
+void SensorItemImpl::writeSDF(SDFWriter& writer)
+{
+    ostream& os = writer.out();
+    string st(sensorType.selectedSymbol());
+    string ct(cameraType.selectedSymbol());
+    string type;
+    if (st == "camera") {
+        type = (ct == "NONE" || ct == "COLOR") ? "camera" : "depth";
+    } else if (st == "range") {
+        type = "ray";
+    } else if (st == "force") {
+        type = "force_torque";
+    } else if (st == "acceleration" || st == "gyro") {
+        type = "imu";
+    } else {
+        return;
+    }
+
+    Vector3 p;
+    Matrix3 R;
+    writer.getRelativePose(self, p, R);
+    if (st == "camera" || st == "range") {
+        // cameras and range sensors look along -z with y up in Choreonoid
+        // and along x with z up in SDF
+        Matrix3 C;
+        C << 0, -1, 0,
+             0,  0, 1,
+            -1,  0, 0;
+        R = R * C;
+    }
+
+    os << "   <sensor name=\"" << self->name() << "\" type=\"" << type << "\">\n";
+    writer.writePose("    ", p, R);
+    if (st == "camera") {
+        os << "    <update_rate>" << frameRate << "</update_rate>\n";
+        os << "    <camera>\n";
+        os << "     <horizontal_fov>" << fieldOfView << "</horizontal_fov>\n";
+        os << "     <image><width>" << resolutionX << "</width><height>" << resolutionY << "</height></image>\n";
+        os << "     <clip><near>" << nearDistance << "</near><far>" << farDistance << "</far></clip>\n";
+        os << "    </camera>\n";
+    } else if (st == "range") {
+        int samples = 1;
+        if (scanStep > 0.0) {
+            samples = static_cast<int>(scanAngle / scanStep + 0.5) + 1;
+        }
+        os << "    <update_rate>" << scanRate << "</update_rate>\n";
+        os << "    <ray>\n";
+        os << "     <scan><horizontal><samples>" << samples << "</samples>"
+           << "<min_angle>" << -scanAngle / 2.0 << "</min_angle>"
+           << "<max_angle>" << scanAngle / 2.0 << "</max_angle></horizontal></scan>\n";
+        os << "     <range><min>" << minDistance << "</min><max>" << maxDistance << "</max></range>\n";
+        os << "    </ray>\n";
+    }
+    os << "   </sensor>\n";
 }
 
 
@@ -680,10 +735,8 @@ bool SensorItem::store(Archive& archive)
 
 bool SensorItemImpl::store(Archive& archive)
 {
-    archive.setDoubleFormat("% .6f");
-
-    write(archive, "position", sceneLink->translation());
-    write(archive, "attitude", Matrix3(sceneLink->rotation()));
+    writeExactly(archive, "position", Vector3(sceneLink->translation()));
+    writeExactly(archive, "attitude", Matrix3(sceneLink->rotation()));
 
     return true;
 }
@@ -708,3 +761,71 @@ bool SensorItemImpl::restore(const Archive& archive)
 
     return true;
 }
+
+
+bool SensorItem::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    return impl->storeState(record, writer);
+}
+
+
+bool SensorItemImpl::storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer)
+{
+    record.type = ModelSnapshotRecord::SENSOR;
+    record.strings[0] = writer.addString(sensorType.selectedSymbol());
+    record.strings[1] = writer.addString(cameraType.selectedSymbol());
+    record.intParams[0] = sensorId;
+    record.intParams[1] = resolutionX;
+    record.intParams[2] = resolutionY;
+    record.params[0] = nearDistance;
+    record.params[1] = farDistance;
+    record.params[2] = fieldOfView;
+    record.params[3] = frameRate;
+    for (int i=0; i < 3; i++) {
+        record.params[4 + i] = maxForce[i];
+        record.params[7 + i] = maxTorque[i];
+        record.params[10 + i] = maxAngularVelocity[i];
+        record.params[13 + i] = maxAcceleration[i];
+    }
+    record.params[16] = scanAngle;
+    record.params[17] = scanStep;
+    record.params[18] = scanRate;
+    record.params[19] = minDistance;
+    record.params[20] = maxDistance;
+    record.params[21] = radius();
+    return true;
+}
+
+
+void SensorItem::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    impl->restoreState(record, reader);
+}
+
+
+void SensorItemImpl::restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader)
+{
+    sensorType.select(reader.string(record.strings[0]));
+    cameraType.select(reader.string(record.strings[1]));
+    sensorId = record.intParams[0];
+    createDevice();
+    resolutionX = record.intParams[1];
+    resolutionY = record.intParams[2];
+    nearDistance = record.params[0];
+    farDistance = record.params[1];
+    fieldOfView = record.params[2];
+    frameRate = record.params[3];
+    for (int i=0; i < 3; i++) {
+        maxForce[i] = record.params[4 + i];
+        maxTorque[i] = record.params[7 + i];
+        maxAngularVelocity[i] = record.params[10 + i];
+        maxAcceleration[i] = record.params[13 + i];
+    }
+    scanAngle = record.params[16];
+    scanStep = record.params[17];
+    scanRate = record.params[18];
+    minDistance = record.params[19];
+    maxDistance = record.params[20];
+    updateDevice();
+    setRadius(record.params[21]);
+}
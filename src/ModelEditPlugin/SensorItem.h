@@ -31,12 +31,16 @@ public:
     SensorItem(Device* dev);
     virtual ~SensorItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    void writeVRML(VRMLModelWriter& writer);
+    void writeURDF(URDFWriter& writer);
+    void writeSDF(SDFWriter& writer);
     
     Device* device() const;
     
     virtual SgNode* getScene();
+    virtual SgPosTransform* sceneTransform();
+    virtual bool storeState(ModelSnapshotRecord& record, ModelSnapshotWriter& writer);
+    virtual void restoreState(const ModelSnapshotRecord& record, const ModelSnapshotReader& reader);
 
 protected:
     virtual Item* doDuplicate() const;
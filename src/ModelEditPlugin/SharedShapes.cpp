@@ -0,0 +1,388 @@
+/**
+   @file
+*/
+
+#include "SharedShapes.h"
+#include <cnoid/SceneDrawables>
+#include <cnoid/MeshGenerator>
+#include <cnoid/MeshNormalGenerator>
+#include <cnoid/EigenUtil>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const char* axisNames[3] = { "x", "y", "z" };
+
+// the shapes are only used by the items in the main thread, and their
+// reference counts are not atomic
+SgGroupPtr axesGizmo;
+size_t axesGizmoBytes = 0;
+SgShapePtr jointAxisDisc;
+
+struct PrimitiveKey
+{
+    int type;
+    double dimensions[3];
+    int divisionNumber;
+
+    bool operator<(const PrimitiveKey& rhs) const {
+        if(type != rhs.type){
+            return type < rhs.type;
+        }
+        for(int i=0; i < 3; ++i){
+            if(dimensions[i] != rhs.dimensions[i]){
+                return dimensions[i] < rhs.dimensions[i];
+            }
+        }
+        return divisionNumber < rhs.divisionNumber;
+    }
+};
+
+/**
+   Meshes shared by the items with the same key. The meshes which are only
+   referenced by the map are removed before a new mesh is inserted into a map
+   which has doubled its size since the last sweep, so the cost of the sweeps
+   is proportional to the number of the insertions.
+   A returned mesh is only referenced by the map until the caller sets it to
+   a shape, which is safe because the items are created by the main thread.
+*/
+template<class Key>
+class SharedMeshMap
+{
+public:
+    SharedMeshMap() : sweepSize(MIN_SWEEP_SIZE) { }
+
+    SgMeshPtr& find(const Key& key) {
+        typename Map::iterator p = meshes.find(key);
+        if(p != meshes.end()){
+            return p->second;
+        }
+        if(meshes.size() >= sweepSize){
+            sweep();
+            sweepSize = std::max(meshes.size() * 2, (size_t)MIN_SWEEP_SIZE);
+        }
+        return meshes[key];
+    }
+
+    size_t size() const { return meshes.size(); }
+
+private:
+    enum { MIN_SWEEP_SIZE = 64 };
+    typedef map<Key, SgMeshPtr> Map;
+    Map meshes;
+    size_t sweepSize;
+
+    void sweep() {
+        typename Map::iterator p = meshes.begin();
+        while(p != meshes.end()){
+            if(!p->second || p->second->refCount() == 1){
+                meshes.erase(p++);
+            } else {
+                ++p;
+            }
+        }
+    }
+};
+
+SharedMeshMap<PrimitiveKey> primitiveMeshes;
+
+struct SensorKey
+{
+    double params[5];
+
+    bool operator<(const SensorKey& rhs) const {
+        for(int i=0; i < 5; ++i){
+            if(params[i] != rhs.params[i]){
+                return params[i] < rhs.params[i];
+            }
+        }
+        return false;
+    }
+};
+
+SgMaterialPtr sensorMaterial;
+SharedMeshMap<SensorKey> cameraFrustums;
+SharedMeshMap<SensorKey> rangeSensorFans;
+
+void createAxesGizmo()
+{
+    axesGizmo = new SgGroup;
+
+    MeshGenerator meshGenerator;
+    SgMeshPtr mesh = meshGenerator.generateArrow(1.8, 0.08, 0.1, 2.5);
+    axesGizmoBytes = sizeof(SgGroup) + SharedShapes::meshBytes(mesh);
+
+    for(int i=0; i < 3; ++i){
+        SgMaterial* material = new SgMaterial;
+        Vector3f color(0.2f, 0.2f, 0.2f);
+        color[i] = 1.0f;
+        material->setDiffuseColor(Vector3f::Zero());
+        material->setEmissiveColor(color);
+        material->setAmbientIntensity(0.0f);
+        material->setTransparency(0.6f);
+
+        SgShape* shape = new SgShape;
+        shape->setMesh(mesh);
+        shape->setMaterial(material);
+
+        SgPosTransform* arrow = new SgPosTransform;
+        arrow->addChild(shape);
+        if(i == 0){
+            arrow->setRotation(AngleAxis(-PI / 2.0, Vector3::UnitZ()));
+        } else if(i == 2){
+            arrow->setRotation(AngleAxis( PI / 2.0, Vector3::UnitX()));
+        }
+        SgInvariantGroup* invariant = new SgInvariantGroup;
+        invariant->setName(axisNames[i]);
+        invariant->addChild(arrow);
+        axesGizmo->addChild(invariant);
+
+        axesGizmoBytes +=
+            sizeof(SgMaterial) + sizeof(SgShape) + sizeof(SgPosTransform) + sizeof(SgInvariantGroup);
+    }
+}
+
+}
+
+
+SgNode* SharedShapes::axesGizmo()
+{
+    if(!::axesGizmo){
+        createAxesGizmo();
+    }
+    return ::axesGizmo;
+}
+
+
+int SharedShapes::numAxesGizmoReferences()
+{
+    if(!::axesGizmo){
+        return 0;
+    }
+    return ::axesGizmo->numParents();
+}
+
+
+/**
+   Returns the memory the items would use for their own copies of the gizmo
+   in addition to the single shared instance
+*/
+size_t SharedShapes::axesGizmoBytesSaved()
+{
+    int n = numAxesGizmoReferences();
+    if(n <= 1){
+        return 0;
+    }
+    return (n - 1) * axesGizmoBytes;
+}
+
+
+SgShape* SharedShapes::jointAxisDisc()
+{
+    if(!::jointAxisDisc){
+        SgMaterial* material = new SgMaterial;
+        material->setDiffuseColor(Vector3f(1.0f, 0.0f, 0.0f));
+        material->setEmissiveColor(Vector3f::Zero());
+        material->setAmbientIntensity(0.0f);
+        material->setTransparency(0.0f);
+        MeshGenerator meshGenerator;
+        ::jointAxisDisc = new SgShape;
+        ::jointAxisDisc->setMesh(meshGenerator.generateDisc(0.15, 0.12));
+        ::jointAxisDisc->setMaterial(material);
+    }
+    return ::jointAxisDisc;
+}
+
+
+SgMesh* SharedShapes::primitiveMesh(int type, const Vector3& size, double radius, double height)
+{
+    MeshGenerator meshGenerator;
+
+    PrimitiveKey key;
+    key.type = type;
+    key.dimensions[0] = key.dimensions[1] = key.dimensions[2] = 0.0;
+    key.divisionNumber = meshGenerator.divisionNumber();
+    switch(type){
+    case SgMesh::BOX:
+        key.dimensions[0] = size[0];
+        key.dimensions[1] = size[1];
+        key.dimensions[2] = size[2];
+        break;
+    case SgMesh::SPHERE:
+        key.dimensions[0] = radius;
+        break;
+    case SgMesh::CYLINDER:
+    case SgMesh::CONE:
+        key.dimensions[0] = radius;
+        key.dimensions[1] = height;
+        break;
+    default:
+        return 0;
+    }
+
+    SgMeshPtr& mesh = primitiveMeshes.find(key);
+    if(!mesh){
+        switch(type){
+        case SgMesh::BOX:
+            mesh = meshGenerator.generateBox(size);
+            break;
+        case SgMesh::SPHERE:
+            mesh = meshGenerator.generateSphere(radius);
+            break;
+        case SgMesh::CYLINDER:
+            mesh = meshGenerator.generateCylinder(radius, height);
+            break;
+        case SgMesh::CONE:
+            mesh = meshGenerator.generateCone(radius, height, true, true);
+            break;
+        }
+    }
+    return mesh;
+}
+
+
+int SharedShapes::numPrimitiveMeshes()
+{
+    return primitiveMeshes.size();
+}
+
+
+SgMaterial* SharedShapes::sensorMaterial()
+{
+    if(!::sensorMaterial){
+        ::sensorMaterial = new SgMaterial;
+        ::sensorMaterial->setDiffuseColor(Vector3f(0.0f, 0.0f, 1.0f));
+        ::sensorMaterial->setEmissiveColor(Vector3f::Zero());
+        ::sensorMaterial->setAmbientIntensity(0.0f);
+        ::sensorMaterial->setTransparency(0.5f);
+    }
+    return ::sensorMaterial;
+}
+
+
+SgMesh* SharedShapes::cameraFrustum(double fieldOfView, int resolutionX, int resolutionY,
+                                    double nearDistance, double farDistance)
+{
+    SensorKey key;
+    key.params[0] = fieldOfView;
+    key.params[1] = resolutionX;
+    key.params[2] = resolutionY;
+    key.params[3] = nearDistance;
+    key.params[4] = farDistance;
+
+    SgMeshPtr& mesh = cameraFrustums.find(key);
+    if(mesh){
+        return mesh;
+    }
+
+    double w = 0.50;
+    double h = 0.40;
+    if (fieldOfView > 0.0 && resolutionX > 0.0 && resolutionY > 0.0) {
+        double aspect = (double)resolutionX / (double)resolutionY;
+        if (aspect >= 1.0) {
+            w = 2.0 * farDistance * tan(fieldOfView / 2.0);
+            h = w / aspect;
+        } else {
+            h = 2.0 * farDistance * tan(fieldOfView / 2.0);
+            w = h * aspect;
+        }
+    }
+    mesh = new SgMesh;
+    SgVertexArray& vertices = *mesh->setVertices(new SgVertexArray());
+    vertices.reserve(8);
+    vertices.push_back(Vector3f(-w/2, -h/2, -farDistance));
+    vertices.push_back(Vector3f(-w/2,  h/2, -farDistance));
+    vertices.push_back(Vector3f( w/2,  h/2, -farDistance));
+    vertices.push_back(Vector3f( w/2, -h/2, -farDistance));
+    if (farDistance > 0.0) {
+        w *= nearDistance/farDistance;
+        h *= nearDistance/farDistance;
+    }
+    vertices.push_back(Vector3f(-w/2, -h/2, -nearDistance));
+    vertices.push_back(Vector3f(-w/2,  h/2, -nearDistance));
+    vertices.push_back(Vector3f( w/2,  h/2, -nearDistance));
+    vertices.push_back(Vector3f( w/2, -h/2, -nearDistance));
+
+    mesh->reserveNumTriangles(12);
+    mesh->addTriangle(0,1,2);
+    mesh->addTriangle(0,2,3);
+    mesh->addTriangle(0,3,4);
+    mesh->addTriangle(4,3,7);
+    mesh->addTriangle(0,4,1);
+    mesh->addTriangle(4,5,1);
+    mesh->addTriangle(1,5,6);
+    mesh->addTriangle(1,6,2);
+    mesh->addTriangle(6,7,3);
+    mesh->addTriangle(6,3,2);
+    mesh->addTriangle(5,4,7);
+    mesh->addTriangle(5,7,6);
+
+    MeshNormalGenerator normalGenerator;
+    normalGenerator.generateNormals(mesh, 0);
+    mesh->updateBoundingBox();
+
+    return mesh;
+}
+
+
+SgMesh* SharedShapes::rangeSensorFan(double scanAngle, double minDistance, double maxDistance)
+{
+    SensorKey key;
+    key.params[0] = scanAngle;
+    key.params[1] = minDistance;
+    key.params[2] = maxDistance;
+    key.params[3] = key.params[4] = 0.0;
+
+    SgMeshPtr& mesh = rangeSensorFans.find(key);
+    if(mesh){
+        return mesh;
+    }
+
+    const int ndiv = scanAngle/0.2+1;
+    mesh = new SgMesh;
+    SgVertexArray& vertices = *mesh->setVertices(new SgVertexArray());
+    vertices.reserve((ndiv+1)*2);
+    for (int i=0; i<=ndiv; i++){
+        double c = cos(scanAngle/ndiv*i-scanAngle/2);
+        double s = sin(scanAngle/ndiv*i-scanAngle/2);
+        vertices.push_back(Vector3f(minDistance*s, 0, -minDistance*c));
+        vertices.push_back(Vector3f(maxDistance*s, 0, -maxDistance*c));
+    }
+
+    mesh->reserveNumTriangles(ndiv*2);
+    for (int i=0; i<ndiv; i++){
+        mesh->addTriangle(i*2+2,i*2+1,i*2  );
+        mesh->addTriangle(i*2+2,i*2+3,i*2+1);
+    }
+
+    MeshNormalGenerator normalGenerator;
+    normalGenerator.generateNormals(mesh, 0);
+    mesh->updateBoundingBox();
+
+    return mesh;
+}
+
+
+int SharedShapes::numSensorMeshes()
+{
+    return cameraFrustums.size() + rangeSensorFans.size();
+}
+
+
+size_t SharedShapes::meshBytes(const SgMesh* mesh)
+{
+    size_t bytes = sizeof(SgMesh);
+    if(mesh->hasVertices()){
+        bytes += mesh->vertices()->size() * sizeof(Vector3f);
+    }
+    if(mesh->hasNormals()){
+        bytes += mesh->normals()->size() * sizeof(Vector3f);
+    }
+    bytes += mesh->normalIndices().size() * sizeof(int);
+    bytes += mesh->triangleVertices().size() * sizeof(int);
+    return bytes;
+}
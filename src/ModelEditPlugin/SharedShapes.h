@@ -0,0 +1,66 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_SHARED_SHAPES_H
+#define CNOID_EDITMODEL_PLUGIN_SHARED_SHAPES_H
+
+#include <cnoid/SceneGraph>
+#include <cnoid/EigenTypes>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgMesh;
+class SgShape;
+class SgMaterial;
+
+/**
+   Immutable scene nodes shared by all the editable items.
+   The nodes must not be modified by the items; per-item attributes such as
+   the scale have to be given by the nodes that reference them.
+*/
+class CNOID_EXPORT SharedShapes
+{
+public:
+    /// three arrows for the x, y and z axes (one arrow mesh and three materials)
+    static SgNode* axesGizmo();
+
+    static int numAxesGizmoReferences();
+    static size_t axesGizmoBytesSaved();
+
+    /// red disc which indicates the rotation plane of a joint
+    static SgShape* jointAxisDisc();
+
+    /**
+       Tessellated mesh of a primitive shape. Meshes are shared by all the
+       shapes with the same type (SgMesh::PrimitiveType), dimensions and
+       division number of the mesh generator. The meshes which are no longer
+       used by any shape are released when new meshes are added.
+    */
+    static SgMesh* primitiveMesh(int type, const Vector3& size, double radius, double height);
+    static int numPrimitiveMeshes();
+
+    /// translucent blue material of the sensor range indicators
+    static SgMaterial* sensorMaterial();
+
+    /**
+       Viewing frustum of a camera, shared by the cameras with the same
+       parameters. The frustums and the fans are released as the primitive
+       meshes when they are no longer used.
+    */
+    static SgMesh* cameraFrustum(double fieldOfView, int resolutionX, int resolutionY,
+                                 double nearDistance, double farDistance);
+
+    /// scanning fan of a range sensor, shared by the sensors with the same parameters
+    static SgMesh* rangeSensorFan(double scanAngle, double minDistance, double maxDistance);
+
+    static int numSensorMeshes();
+
+    static size_t meshBytes(const SgMesh* mesh);
+};
+
+}
+
+#endif
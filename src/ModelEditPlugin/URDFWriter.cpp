@@ -0,0 +1,138 @@
+/**
+   @file
+*/
+
+#include "URDFWriter.h"
+#include "EditableModelBase.h"
+#include "JointItem.h"
+#include "DoubleFormatter.h"
+#include "ModelFileStream.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/NullOut>
+#include <boost/filesystem.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+
+URDFWriter::URDFWriter(std::ostream& os)
+    : os(os),
+      messageOut_(&nullout()),
+      isWorldLinkWritten(false)
+{
+    setPrecision(0);
+}
+
+
+void URDFWriter::setMessageSink(std::ostream& os)
+{
+    messageOut_ = &os;
+}
+
+
+void URDFWriter::setPrecision(int precision)
+{
+    os.imbue(DoubleFormatter::locale(precision));
+}
+
+
+void URDFWriter::setOutFileName(const std::string& filename)
+{
+    outDirectory_ = boost::filesystem::path(filename).parent_path().string();
+}
+
+
+void URDFWriter::writeRobot(Item* modelItem)
+{
+    os << "<robot name=\"" << modelItem->name() << "\">\n";
+    writeChildren(modelItem);
+    os << "</robot>\n";
+}
+
+
+/**
+   Writes the descendants of the item down to the nearest joint items, which
+   write their own descendants. The other items are attached to the link of
+   their nearest parent joint in the same way as the SDF writer does.
+*/
+void URDFWriter::writeChildren(Item* item)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        EditableModelBase* modelItem = dynamic_cast<EditableModelBase*>(child);
+        if(modelItem){
+            modelItem->writeURDF(*this);
+        }
+        if(!dynamic_cast<JointItem*>(child)){
+            writeChildren(child);
+        }
+    }
+}
+
+
+void URDFWriter::getRelativePose
+(EditableModelBase* frame, EditableModelBase* item, Vector3& out_p, Matrix3& out_R) const
+{
+    if(frame){
+        const Matrix3 Rt = frame->absRotation.transpose();
+        out_p = Rt * (item->absTranslation - frame->absTranslation);
+        out_R = Rt * item->absRotation;
+    } else {
+        out_p = item->absTranslation;
+        out_R = item->absRotation;
+    }
+}
+
+
+void URDFWriter::writeOrigin(const char* indent, const Vector3& p, const Matrix3& R)
+{
+    const Vector3 rpy = rpyFromRot(R);
+    os << indent << "<origin xyz=\"" << p[0] << " " << p[1] << " " << p[2]
+       << "\" rpy=\"" << rpy[0] << " " << rpy[1] << " " << rpy[2] << "\"/>\n";
+}
+
+
+void URDFWriter::writeWorldLink()
+{
+    if(!isWorldLinkWritten){
+        os << "<link name=\"world\"/>\n";
+        isWorldLinkWritten = true;
+    }
+}
+
+
+void URDFWriter::writeShapeJoint(EditableModelBase* item, const std::string& linkName)
+{
+    JointItem* parentJoint = JointItem::findParentJoint(item);
+    os << "<joint name=\"" << linkName << "_JOINT\" type=\"fixed\">\n";
+    if(parentJoint){
+        os << " <parent link=\"" << parentJoint->name() << "_LINK\"/>\n";
+    } else {
+        os << " <parent link=\"world\"/>\n";
+    }
+    os << " <child link=\"" << linkName << "\"/>\n";
+    os << "</joint>\n";
+    if(!parentJoint){
+        writeWorldLink();
+    }
+}
+
+
+bool URDFWriter::save(Item* modelItem, const std::string& filename, std::ostream& messageOut,
+                      int numMeshThreads)
+{
+    ModelOutputFile file(filename);
+    if(!file.isOpen()){
+        return false;
+    }
+    URDFWriter writer(file.stream());
+    writer.setMessageSink(messageOut);
+    writer.setOutFileName(filename);
+    writer.writeRobot(modelItem);
+    if(!file.close()){
+        return false;
+    }
+    bool exported = writer.meshExporter().exportMeshes(writer.outDirectory(), numMeshThreads);
+    writer.meshExporter().putSummary(messageOut);
+    return exported;
+}
@@ -0,0 +1,77 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_URDF_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_URDF_WRITER_H
+
+#include <cnoid/Item>
+#include <cnoid/EigenTypes>
+#include "MeshExporter.h"
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class EditableModelBase;
+
+/**
+   Writes the URDF description of an item tree to a stream.
+   The items append their elements to the stream during a single traversal
+   of the tree, so no intermediate strings are built for the subtrees.
+*/
+class CNOID_EXPORT URDFWriter
+{
+public:
+    URDFWriter(std::ostream& os);
+
+    std::ostream& out() { return os; }
+
+    /// stream of the warnings, which are discarded by default
+    void setMessageSink(std::ostream& os);
+    std::ostream& messageOut() { return *messageOut_; }
+
+    /// significant digits of the doubles, 0 for the shortest exact digits
+    void setPrecision(int precision);
+
+    void setOutFileName(const std::string& filename);
+    const std::string& outDirectory() const { return outDirectory_; }
+
+    /// meshes referred by the document, exported by save() after the document is written
+    MeshExporter& meshExporter() { return meshExporter_; }
+
+    void writeRobot(Item* modelItem);
+    void writeChildren(Item* item);
+
+    /// pose of the item in the frame of another item, or in the model frame when frame is null
+    void getRelativePose(EditableModelBase* frame, EditableModelBase* item,
+                         Vector3& out_p, Matrix3& out_R) const;
+    void writeOrigin(const char* indent, const Vector3& p, const Matrix3& R);
+
+    /// writes the world link on the first call only
+    void writeWorldLink();
+
+    /**
+       Writes a fixed joint attaching the link of a shape item to the link of
+       its nearest parent joint, or to the world link. The frame of the shape link
+       equals the frame of the parent link, so the pose of the shape is
+       written as the origin of its visual and collision elements.
+    */
+    void writeShapeJoint(EditableModelBase* item, const std::string& linkName);
+
+    /// the meshes are exported with numMeshThreads threads, or the hardware threads when it is zero
+    static bool save(Item* modelItem, const std::string& filename, std::ostream& messageOut,
+                     int numMeshThreads = 0);
+
+private:
+    std::ostream& os;
+    std::ostream* messageOut_;
+    std::string outDirectory_;
+    bool isWorldLinkWritten;
+    MeshExporter meshExporter_;
+};
+
+}
+
+#endif
@@ -0,0 +1,307 @@
+/**
+   @file
+*/
+
+#include "VRMLModelWriter.h"
+#include "EditableModelBase.h"
+#include "DoubleFormatter.h"
+#include "ModelFileStream.h"
+#include <cnoid/VRMLBodyWriter>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const char* keywords[] = {
+    "DEF", "EXTERNPROTO", "FALSE", "IS", "NULL", "PROTO", "ROUTE", "TO", "TRUE", "USE",
+    "eventIn", "eventOut", "exposedField", "field"
+};
+
+// the characters which cannot be a part of an identifier in VRML97
+bool isInvalidIdChar(char c)
+{
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u <= 0x20 || u == 0x7f || std::strchr("\"#',.[\\]{}", c) != 0;
+}
+
+void collectDefNames(VRMLNode* node, set<string>& names)
+{
+    if(!node){
+        return;
+    }
+    if(!node->defName.empty()){
+        names.insert(node->defName);
+    }
+    if(VRMLGroup* group = dynamic_cast<VRMLGroup*>(node)){
+        for(int i=0; i < group->countChildren(); ++i){
+            collectDefNames(group->getChild(i), names);
+        }
+    } else if(VRMLShape* shape = dynamic_cast<VRMLShape*>(node)){
+        collectDefNames(shape->geometry.get(), names);
+        if(VRMLAppearance* appearance = dynamic_cast<VRMLAppearance*>(shape->appearance.get())){
+            collectDefNames(appearance, names);
+            collectDefNames(appearance->material.get(), names);
+        }
+    } else if(VRMLProtoInstance* proto = dynamic_cast<VRMLProtoInstance*>(node)){
+        for(VRMLProtoFieldMap::iterator p = proto->fields.begin(); p != proto->fields.end(); ++p){
+            if(MFNode* nodes = boost::get<MFNode>(&p->second)){
+                for(size_t i=0; i < nodes->size(); ++i){
+                    collectDefNames((*nodes)[i].get(), names);
+                }
+            }
+        }
+    }
+}
+
+// the DEF names in the nodes of the original model, which are written as they are
+void collectOriginalDefNames(Item* item, set<string>& names)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        EditableModelBase* modelItem = dynamic_cast<EditableModelBase*>(child);
+        if(modelItem){
+            VRMLProtoInstance* original = dynamic_cast<VRMLProtoInstance*>(modelItem->originalNode.get());
+            if(original){
+                VRMLProtoFieldMap::iterator p = original->fields.find("children");
+                if(p != original->fields.end()){
+                    if(MFNode* nodes = boost::get<MFNode>(&p->second)){
+                        for(size_t i=0; i < nodes->size(); ++i){
+                            collectDefNames((*nodes)[i].get(), names);
+                        }
+                    }
+                }
+            }
+        }
+        collectOriginalDefNames(child, names);
+    }
+}
+
+// escapes the characters which end a string in VRML97
+string escapeString(const string& value)
+{
+    string escaped;
+    escaped.reserve(value.size());
+    for(size_t i=0; i < value.size(); ++i){
+        if(value[i] == '"' || value[i] == '\\'){
+            escaped += '\\';
+        }
+        escaped += value[i];
+    }
+    return escaped;
+}
+
+}
+
+
+VRMLModelWriter::VRMLModelWriter(std::ostream& os)
+    : os(os),
+      nodeWriter(new VRMLBodyWriter(os))
+{
+    setPrecision(0);
+}
+
+
+void VRMLModelWriter::setPrecision(int precision)
+{
+    os.imbue(DoubleFormatter::locale(precision));
+}
+
+
+VRMLModelWriter::~VRMLModelWriter()
+{
+
+}
+
+
+void VRMLModelWriter::setOutFileName(const std::string& filename)
+{
+    nodeWriter->setOutFileName(filename);
+}
+
+
+void VRMLModelWriter::writeModel(Item* modelItem)
+{
+    nodeWriter->writeHeader();
+    os << "\n";
+    nodeWriter->writeOpenHRPPROTOs();
+
+    jointNames.clear();
+    segmentNames.clear();
+    defNames.clear();
+    // the generated names must not collide with the names kept from the original model
+    collectOriginalDefNames(modelItem, defNames);
+
+    beginNode("Humanoid");
+    beginField("humanoidBody");
+    writeChildItems(modelItem);
+    endField();
+    writeUseList("joints", jointNames);
+    writeUseList("segments", segmentNames);
+    writeField("name", modelItem->name());
+    writeField("version", string("1.1"));
+    endNode();
+}
+
+
+void VRMLModelWriter::writeUseList(const char* name, const std::vector<std::string>& names)
+{
+    beginField(name);
+    for(size_t i=0; i < names.size(); ++i){
+        os << indent_ << "USE " << names[i] << "\n";
+    }
+    endField();
+}
+
+
+void VRMLModelWriter::writeChildren(Item* item)
+{
+    bool hasChildren = false;
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        if(dynamic_cast<EditableModelBase*>(child)){
+            hasChildren = true;
+            break;
+        }
+    }
+    if(hasChildren){
+        beginField("children");
+        writeChildItems(item);
+        endField();
+    }
+}
+
+
+void VRMLModelWriter::writeChildItems(Item* item)
+{
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        EditableModelBase* modelItem = dynamic_cast<EditableModelBase*>(child);
+        if(modelItem){
+            modelItem->writeVRML(*this);
+        }
+    }
+}
+
+
+void VRMLModelWriter::writeNode(VRMLNode* node)
+{
+    if(node){
+        nodeWriter->writeNode(node);
+    }
+}
+
+
+void VRMLModelWriter::writeInline(const std::string& url)
+{
+    VRMLInlinePtr inlineNode = new VRMLInline();
+    inlineNode->urls.push_back(url);
+    nodeWriter->writeNode(inlineNode);
+}
+
+
+std::string VRMLModelWriter::beginNode(const char* type, const std::string& name)
+{
+    string defName;
+    os << indent_;
+    if(!name.empty()){
+        defName = makeDefName(name);
+        os << "DEF " << defName << " ";
+    }
+    os << type << " {\n";
+    indent_ += "  ";
+    return defName;
+}
+
+
+std::string VRMLModelWriter::makeDefName(const std::string& name)
+{
+    string id(name);
+    for(size_t i=0; i < id.size(); ++i){
+        if(isInvalidIdChar(id[i])){
+            id[i] = '_';
+        }
+    }
+    if(id[0] == '+' || id[0] == '-' || (id[0] >= '0' && id[0] <= '9')){
+        id.insert(0, 1, '_');
+    }
+    for(size_t i=0; i < sizeof(keywords) / sizeof(keywords[0]); ++i){
+        if(id == keywords[i]){
+            id += "_";
+            break;
+        }
+    }
+    string defName(id);
+    for(int suffix = 2; !defNames.insert(defName).second; ++suffix){
+        ostringstream oss;
+        oss << id << "_" << suffix;
+        defName = oss.str();
+    }
+    return defName;
+}
+
+
+void VRMLModelWriter::endNode()
+{
+    indent_.resize(indent_.size() - 2);
+    os << indent_ << "}\n";
+}
+
+
+void VRMLModelWriter::beginField(const char* name)
+{
+    os << indent_ << name << " [\n";
+    indent_ += "  ";
+}
+
+
+void VRMLModelWriter::endField()
+{
+    indent_.resize(indent_.size() - 2);
+    os << indent_ << "]\n";
+}
+
+
+void VRMLModelWriter::writeField(const char* name, double value)
+{
+    os << indent_ << name << " " << value << "\n";
+}
+
+
+void VRMLModelWriter::writeField(const char* name, int value)
+{
+    os << indent_ << name << " " << value << "\n";
+}
+
+
+void VRMLModelWriter::writeField(const char* name, const std::string& value)
+{
+    os << indent_ << name << " \"" << escapeString(value) << "\"\n";
+}
+
+
+void VRMLModelWriter::writeField(const char* name, const Vector3& value)
+{
+    os << indent_ << name << " " << value[0] << " " << value[1] << " " << value[2] << "\n";
+}
+
+
+void VRMLModelWriter::writePose(const Vector3& translation, const Matrix3& rotation)
+{
+    const AngleAxis aa(rotation);
+    writeField("translation", translation);
+    os << indent_ << "rotation " << aa.axis()[0] << " " << aa.axis()[1] << " " << aa.axis()[2]
+       << " " << aa.angle() << "\n";
+}
+
+
+bool VRMLModelWriter::save(Item* modelItem, const std::string& filename)
+{
+    ModelOutputFile file(filename);
+    if(!file.isOpen()){
+        return false;
+    }
+    VRMLModelWriter writer(file.stream());
+    writer.setOutFileName(filename);
+    writer.writeModel(modelItem);
+    return file.close();
+}
@@ -0,0 +1,87 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_VRML_MODEL_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_VRML_MODEL_WRITER_H
+
+#include <cnoid/Item>
+#include <cnoid/VRML>
+#include <cnoid/EigenTypes>
+#include <boost/scoped_ptr.hpp>
+#include <string>
+#include <vector>
+#include <set>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class VRMLBodyWriter;
+
+/**
+   Writes an item tree as an OpenHRP VRML model.
+   The items write their PROTO instances to the stream while the tree is
+   traversed instead of building a VRML node tree for the whole model.
+   The nodes kept from the original model file are written as they are.
+*/
+class CNOID_EXPORT VRMLModelWriter
+{
+public:
+    VRMLModelWriter(std::ostream& os);
+    ~VRMLModelWriter();
+
+    std::ostream& out() { return os; }
+    const std::string& indent() const { return indent_; }
+
+    /// significant digits of the doubles, 0 for the shortest exact digits
+    void setPrecision(int precision);
+
+    void setOutFileName(const std::string& filename);
+
+    void writeModel(Item* modelItem);
+
+    /// writes the children field if the item has any child to write
+    void writeChildren(Item* item);
+    /// writes the child items into a children field opened by the caller
+    void writeChildItems(Item* item);
+    void writeNode(VRMLNode* node);
+    void writeInline(const std::string& url);
+
+    /**
+       Opens a node. A name given to the node is written as a DEF name, which
+       is made a valid VRML identifier unique in the file by replacing the
+       invalid characters and appending a suffix. The written name is returned.
+    */
+    std::string beginNode(const char* type, const std::string& name = std::string());
+    void endNode();
+    void beginField(const char* name);
+    void endField();
+
+    void writeField(const char* name, double value);
+    void writeField(const char* name, int value);
+    void writeField(const char* name, const std::string& value);
+    void writeField(const char* name, const Vector3& value);
+    void writePose(const Vector3& translation, const Matrix3& rotation);
+
+    /// the joints and the segments listed in the Humanoid node by the names returned by beginNode()
+    void addJoint(const std::string& defName) { jointNames.push_back(defName); }
+    void addSegment(const std::string& defName) { segmentNames.push_back(defName); }
+
+    static bool save(Item* modelItem, const std::string& filename);
+
+private:
+    std::ostream& os;
+    boost::scoped_ptr<VRMLBodyWriter> nodeWriter;
+    std::string indent_;
+    std::vector<std::string> jointNames;
+    std::vector<std::string> segmentNames;
+    std::set<std::string> defNames;
+
+    std::string makeDefName(const std::string& name);
+    void writeUseList(const char* name, const std::vector<std::string>& names);
+};
+
+}
+
+#endif